@@ -0,0 +1,108 @@
+#include <linux/limits.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef ABS_ARCHIVE
+
+/*
+ * Minimal reader for GNU `ar` archives (regular and thin), used to decide
+ * whether a static library can be updated in place. Only member names are
+ * read; the symbol table and object contents are skipped.
+ */
+
+typedef struct {
+    bool   thin;
+    char **members;     // member file names (basenames)
+    size_t members_n;
+} ar_index;
+
+void ar_index_free(ar_index *idx){
+    for (size_t i = 0; i < idx->members_n; i++) free(idx->members[i]);
+    free(idx->members);
+    memset(idx, 0, sizeof(*idx));
+}
+
+static void _ar_add_member(ar_index *idx, const char *name, size_t len){
+    // GNU terminates names with '/'; keep only the basename
+    while (len > 0 && (name[len - 1] == '/' || name[len - 1] == ' ' || name[len - 1] == '\n')) len--;
+    const char *base = name;
+    for (size_t i = 0; i < len; i++){
+        if (name[i] == '/') base = name + i + 1;
+    }
+    len -= base - name;
+
+    char **tmp = realloc(idx->members, sizeof(char*) * (idx->members_n + 1));
+    if (!tmp) return;
+    idx->members = tmp;
+    idx->members[idx->members_n++] = strndup(base, len);
+}
+
+// returns 0 on success, -1 when the file is missing or not an archive
+int ar_read_index(const char *path, ar_index *idx){
+    memset(idx, 0, sizeof(*idx));
+
+    FILE *f = fopen(path, "rb");
+    if (!f) return -1;
+
+    char magic[8];
+    if (fread(magic, 1, 8, f) != 8){
+        fclose(f);
+        return -1;
+    }
+    if (memcmp(magic, "!<arch>\n", 8) == 0)      idx->thin = false;
+    else if (memcmp(magic, "!<thin>\n", 8) == 0) idx->thin = true;
+    else {
+        fclose(f);
+        return -1;
+    }
+
+    char *names = NULL;   // the `//` long name table
+    size_t names_len = 0;
+    char hdr[60];
+
+    while (fread(hdr, 1, 60, f) == 60){
+        char size_str[11] = {0};
+        memcpy(size_str, hdr + 48, 10);
+        long size = strtol(size_str, NULL, 10);
+        long padded = size + (size & 1);
+
+        if (memcmp(hdr, "//              ", 16) == 0){
+            free(names);
+            names = malloc(size + 1);
+            if (!names || fread(names, 1, size, f) != (size_t)size) break;
+            names[size] = '\0';
+            names_len = size;
+            if (size & 1) fseek(f, 1, SEEK_CUR);
+            continue;
+        }
+
+        // symbol tables: `/` and `/SYM64/`
+        int is_symtab = hdr[0] == '/' && (hdr[1] == ' ' || memcmp(hdr, "/SYM64/", 7) == 0);
+
+        if (!is_symtab){
+            if (hdr[0] == '/' && names){
+                size_t off = strtoul(hdr + 1, NULL, 10);
+                if (off < names_len){
+                    const char *end = strchr(names + off, '\n');
+                    size_t len = end ? (size_t)(end - (names + off)) : strlen(names + off);
+                    _ar_add_member(idx, names + off, len);
+                }
+            } else {
+                _ar_add_member(idx, hdr, 16);
+            }
+        }
+
+        // thin archives carry no data for regular members
+        if (idx->thin && !is_symtab) continue;
+        if (fseek(f, padded, SEEK_CUR) != 0) break;
+    }
+
+    free(names);
+    fclose(f);
+    return 0;
+}
+
+#endif
+#define ABS_ARCHIVE
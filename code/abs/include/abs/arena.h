@@ -0,0 +1,215 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef ABS_ARENA
+
+/*
+ * Allocation for the per-build model. Paths and arrays that live exactly as
+ * long as one planned build come from an arena and go away in one call, and
+ * strings that repeat are interned so equal paths share one copy and
+ * compare by pointer.
+ */
+
+#define ABS_ARENA_CHUNK (64 * 1024)
+
+typedef struct _abs_arena_chunk {
+    struct _abs_arena_chunk *next;
+    size_t used;
+    size_t cap;
+    max_align_t data[];
+} _abs_arena_chunk;
+
+typedef struct {
+    _abs_arena_chunk *head;
+    size_t bytes;           // handed out so far, for --stats
+} abs_arena;
+
+void *arena_alloc(abs_arena *a, size_t size){
+    size = (size + sizeof(max_align_t) - 1) & ~(sizeof(max_align_t) - 1);
+    _abs_arena_chunk *c = a->head;
+    if (!c || c->cap - c->used < size){
+        // oversized requests get a chunk of their own behind the current one
+        size_t cap = size > ABS_ARENA_CHUNK / 4 ? size : ABS_ARENA_CHUNK;
+        _abs_arena_chunk *n = malloc(sizeof(_abs_arena_chunk) + cap);
+        if (!n) return NULL;
+        n->used = 0;
+        n->cap = cap;
+        if (c && cap != ABS_ARENA_CHUNK){
+            n->next = c->next;
+            c->next = n;
+        } else {
+            n->next = c;
+            a->head = n;
+        }
+        c = n;
+    }
+    void *p = (char *)c->data + c->used;
+    c->used += size;
+    a->bytes += size;
+    return p;
+}
+
+char *arena_strndup(abs_arena *a, const char *s, size_t len){
+    char *p = arena_alloc(a, len + 1);
+    if (!p) return NULL;
+    memcpy(p, s, len);
+    p[len] = '\0';
+    return p;
+}
+
+void arena_free(abs_arena *a){
+    for (_abs_arena_chunk *c = a->head, *next; c; c = next){
+        next = c->next;
+        free(c);
+    }
+    a->head = NULL;
+    a->bytes = 0;
+}
+
+/*
+ * Grows `*arr` of `n` elements for one more. Capacity is implicit, the
+ * next power of two, so arrays keep their plain pointer and count and
+ * appending stays amortized O(1). Only for arrays built from empty here.
+ */
+static int abs_grow(void *arr, size_t n, size_t elem){
+    if (n & (n - 1)) return 0;
+    void *tmp = realloc(*(void **)arr, elem * (n ? n * 2 : 1));
+    if (!tmp) return -1;
+    *(void **)arr = tmp;
+    return 0;
+}
+
+// open addressing set of arena strings
+typedef struct {
+    abs_arena   *arena;
+    const char **slots;
+    size_t       n;
+    size_t       cap;    // power of two, 0 until the first string
+} abs_strtab;
+
+static uint64_t _strtab_hash(const char *s, size_t len){
+    uint64_t h = 1469598103934665603ULL;
+    for (size_t i = 0; i < len; i++){
+        h ^= (unsigned char)s[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+// index of `s` in `slots`, or of the empty slot it would take
+static size_t _strtab_probe(const char **slots, size_t cap, const char *s, size_t len){
+    size_t mask = cap - 1;
+    for (size_t i = _strtab_hash(s, len) & mask; ; i = (i + 1) & mask){
+        const char *e = slots[i];
+        if (!e || (strncmp(e, s, len) == 0 && e[len] == '\0')) return i;
+    }
+}
+
+static const char **_strtab_slot(const abs_strtab *t, const char *s, size_t len){
+    return &t->slots[_strtab_probe(t->slots, t->cap, s, len)];
+}
+
+// the interned copy of `s`, or NULL when it was never interned
+const char *strtab_find(const abs_strtab *t, const char *s){
+    if (t->cap == 0) return NULL;
+    return *_strtab_slot(t, s, strlen(s));
+}
+
+const char *strtab_intern(abs_strtab *t, const char *s, size_t len){
+    if (t->n * 2 >= t->cap){
+        size_t cap = t->cap ? t->cap * 2 : 64;
+        const char **old = t->slots;
+        size_t old_cap = t->cap;
+        t->slots = calloc(cap, sizeof(char *));
+        if (!t->slots){
+            t->slots = old;
+            return NULL;
+        }
+        t->cap = cap;
+        for (size_t i = 0; i < old_cap; i++){
+            if (old[i]) *_strtab_slot(t, old[i], strlen(old[i])) = old[i];
+        }
+        free(old);
+    }
+
+    const char **slot = _strtab_slot(t, s, len);
+    if (!*slot){
+        *slot = arena_strndup(t->arena, s, len);
+        if (!*slot) return NULL;
+        t->n++;
+    }
+    return *slot;
+}
+
+// the strings stay in the arena
+void strtab_free(abs_strtab *t){
+    free(t->slots);
+    t->slots = NULL;
+    t->n = t->cap = 0;
+}
+
+// strings of an arena to indices into an array kept by the caller
+typedef struct {
+    abs_arena   *arena;
+    const char **keys;
+    size_t      *values;
+    size_t       n;
+    size_t       cap;    // power of two, 0 until the first key
+} abs_strmap;
+
+// the interned key of `s`, with its value in `*value`, or NULL
+const char *strmap_get(const abs_strmap *m, const char *s, size_t *value){
+    if (m->cap == 0) return NULL;
+    size_t i = _strtab_probe(m->keys, m->cap, s, strlen(s));
+    if (m->keys[i] && value) *value = m->values[i];
+    return m->keys[i];
+}
+
+// sets the value of `s`, returns its interned key
+const char *strmap_put(abs_strmap *m, const char *s, size_t value){
+    size_t len = strlen(s);
+    if (m->n * 2 >= m->cap){
+        size_t cap = m->cap ? m->cap * 2 : 64;
+        const char **keys = calloc(cap, sizeof(char *));
+        size_t *values = malloc(cap * sizeof(size_t));
+        if (!keys || !values){
+            free(keys);
+            free(values);
+            return NULL;
+        }
+        for (size_t i = 0; i < m->cap; i++){
+            if (!m->keys[i]) continue;
+            size_t j = _strtab_probe(keys, cap, m->keys[i], strlen(m->keys[i]));
+            keys[j] = m->keys[i];
+            values[j] = m->values[i];
+        }
+        free(m->keys);
+        free(m->values);
+        m->keys = keys;
+        m->values = values;
+        m->cap = cap;
+    }
+
+    size_t i = _strtab_probe(m->keys, m->cap, s, len);
+    if (!m->keys[i]){
+        m->keys[i] = arena_strndup(m->arena, s, len);
+        if (!m->keys[i]) return NULL;
+        m->n++;
+    }
+    m->values[i] = value;
+    return m->keys[i];
+}
+
+void strmap_free(abs_strmap *m){
+    free(m->keys);
+    free(m->values);
+    m->keys = NULL;
+    m->values = NULL;
+    m->n = m->cap = 0;
+}
+
+#endif
+#define ABS_ARENA
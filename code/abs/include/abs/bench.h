@@ -0,0 +1,365 @@
+#include "compilation.h"
+#include <limits.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <time.h>
+
+#ifndef ABS_BENCH
+
+/*
+ * `abs bench`. Benchmark binaries listed in [bench] are built in release
+ * mode and run one at a time, `repetitions` times each after `warmup`
+ * discarded runs, optionally pinned to one CPU. Results are written to
+ * <objects>/bench/results.json and compared with
+ * <objects>/bench/baseline.json when it exists.
+ *
+ * A benchmark regresses when its median got slower by more than
+ * `threshold` percent and the difference of the means is larger than
+ * twice their combined standard error, so noisy runs alone do not fail.
+ */
+
+#define ABS_BENCH_MAX_REPS 1000
+
+typedef struct {
+    bool        save_baseline;  // store this run as the new baseline
+    const char *baseline;       // compare against this file instead
+} bench_opts;
+
+typedef struct {
+    char   *name;
+    size_t  runs;
+    double  mean_ms;
+    double  median_ms;
+    double  stddev_ms;
+    double  min_ms;
+    double  max_ms;
+    double  cpu_ms;         // mean user + system time of the child
+    bool    failed;
+} bench_result;
+
+typedef struct {
+    bench_result *results;
+    size_t        n;
+} bench_set;
+
+static void bench_set_free(bench_set *s){
+    for (size_t i = 0; i < s->n; i++) free(s->results[i].name);
+    free(s->results);
+    memset(s, 0, sizeof(*s));
+}
+
+static bench_result *bench_find(const bench_set *s, const char *name){
+    for (size_t i = 0; i < s->n; i++){
+        if (strcmp(s->results[i].name, name) == 0) return &s->results[i];
+    }
+    return NULL;
+}
+
+// Newton's method, so abs does not need libm
+static double _bench_sqrt(double x){
+    if (x <= 0) return 0;
+    double r = x > 1 ? x : 1;
+    for (int i = 0; i < 64; i++){
+        double next = (r + x / r) / 2;
+        if (next >= r) break;
+        r = next;
+    }
+    return r;
+}
+
+static int _bench_cmp_double(const void *a, const void *b){
+    double da = *(const double*)a, db = *(const double*)b;
+    return (da > db) - (da < db);
+}
+
+static void bench_stats(bench_result *r, double *samples, size_t n){
+    r->runs = n;
+    if (n == 0) return;
+
+    qsort(samples, n, sizeof(double), _bench_cmp_double);
+    double sum = 0;
+    for (size_t i = 0; i < n; i++) sum += samples[i];
+    r->mean_ms = sum / n;
+    r->median_ms = n % 2 ? samples[n / 2] : (samples[n / 2 - 1] + samples[n / 2]) / 2;
+    r->min_ms = samples[0];
+    r->max_ms = samples[n - 1];
+
+    double var = 0;
+    for (size_t i = 0; i < n; i++) var += (samples[i] - r->mean_ms) * (samples[i] - r->mean_ms);
+    r->stddev_ms = n > 1 ? _bench_sqrt(var / (n - 1)) : 0;
+}
+
+/*
+ * One run of `cmd` through `sh -c`, output appended to `log_fd`. Returns
+ * the wall time in ms, or -1 when the benchmark did not exit with 0.
+ */
+static double bench_run_once(const char *cmd, int cpu, int log_fd, double *cpu_ms){
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    pid_t pid = fork();
+    if (pid == 0){
+        if (cpu >= 0){
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(cpu, &set);
+            sched_setaffinity(0, sizeof(set), &set);
+        }
+        if (log_fd >= 0){
+            dup2(log_fd, STDOUT_FILENO);
+            dup2(log_fd, STDERR_FILENO);
+        }
+        execl("/bin/sh", "sh", "-c", cmd, (char*)NULL);
+        _exit(127);
+    }
+    if (pid < 0) return -1;
+
+    int status;
+    struct rusage ru;
+    while (wait4(pid, &status, 0, &ru) < 0){
+        if (errno != EINTR) return -1;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    *cpu_ms = (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000.0 +
+              (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1000.0;
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) return -1;
+    return (end.tv_sec - start.tv_sec) * 1000.0 + (end.tv_nsec - start.tv_nsec) / 1e6;
+}
+
+static void _bench_json_string(FILE *f, const char *s){
+    fputc('"', f);
+    for (; *s; s++){
+        if (*s == '"' || *s == '\\') fputc('\\', f);
+        if ((unsigned char)*s < 0x20) fprintf(f, "\\u%04x", *s);
+        else fputc(*s, f);
+    }
+    fputc('"', f);
+}
+
+// one benchmark per line, so bench_load can read it back without a JSON parser
+static int bench_save(const bench_set *s, const char *path, const char *mode){
+    char tmp[PATH_MAX + 8];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE *f = fopen(tmp, "w");
+    if (!f) return -1;
+
+    fprintf(f, "{\n  \"mode\": ");
+    _bench_json_string(f, mode);
+    fprintf(f, ",\n  \"time\": %lld,\n  \"benchmarks\": [\n", (long long)time(NULL));
+    for (size_t i = 0; i < s->n; i++){
+        const bench_result *r = &s->results[i];
+        fprintf(f, "    {\"name\": ");
+        _bench_json_string(f, r->name);
+        fprintf(f, ", \"runs\": %zu, \"failed\": %s, \"mean_ms\": %.6f, \"median_ms\": %.6f, "
+                   "\"stddev_ms\": %.6f, \"min_ms\": %.6f, \"max_ms\": %.6f, \"cpu_ms\": %.6f}%s\n",
+                r->runs, r->failed ? "true" : "false", r->mean_ms, r->median_ms,
+                r->stddev_ms, r->min_ms, r->max_ms, r->cpu_ms, i + 1 < s->n ? "," : "");
+    }
+    fprintf(f, "  ]\n}\n");
+
+    if (fclose(f) != 0 || rename(tmp, path) != 0){
+        unlink(tmp);
+        return -1;
+    }
+    return 0;
+}
+
+static double _bench_field(const char *line, const char *key){
+    char pattern[64];
+    snprintf(pattern, sizeof(pattern), "\"%s\": ", key);
+    const char *p = strstr(line, pattern);
+    return p ? strtod(p + strlen(pattern), NULL) : 0;
+}
+
+static int bench_load(bench_set *s, const char *path){
+    memset(s, 0, sizeof(*s));
+    FILE *f = fopen(path, "r");
+    if (!f) return -1;
+
+    char line[PATH_MAX + 512];
+    while (fgets(line, sizeof(line), f)){
+        const char *p = strstr(line, "{\"name\": \"");
+        if (!p) continue;
+        p += strlen("{\"name\": \"");
+
+        char name[PATH_MAX];
+        size_t len = 0;
+        for (; *p && *p != '"' && len + 1 < sizeof(name); p++){
+            if (*p == '\\' && p[1]) p++;
+            name[len++] = *p;
+        }
+        name[len] = '\0';
+
+        bench_result *tmp = realloc(s->results, sizeof(bench_result) * (s->n + 1));
+        if (!tmp) break;
+        s->results = tmp;
+        bench_result *r = &s->results[s->n++];
+        memset(r, 0, sizeof(*r));
+        r->name = strdup(name);
+        r->runs = (size_t)_bench_field(line, "runs");
+        r->mean_ms = _bench_field(line, "mean_ms");
+        r->median_ms = _bench_field(line, "median_ms");
+        r->stddev_ms = _bench_field(line, "stddev_ms");
+        r->min_ms = _bench_field(line, "min_ms");
+        r->max_ms = _bench_field(line, "max_ms");
+        r->cpu_ms = _bench_field(line, "cpu_ms");
+        r->failed = strstr(line, "\"failed\": true") != NULL;
+    }
+    fclose(f);
+    return 0;
+}
+
+static int _bench_copy(const char *from, const char *to){
+    size_t len = 0;
+    char *data = exec_read_file(from, &len);
+    if (!data) return -1;
+    int r = exec_write_file(to, data, len);
+    free(data);
+    return r;
+}
+
+// percentage change of the median, or 0 when the baseline is unusable
+static bool bench_regressed(const bench_result *now, const bench_result *base,
+                            double threshold, double *change){
+    *change = 0;
+    if (base->failed || base->median_ms <= 0 || now->failed) return false;
+    *change = (now->median_ms - base->median_ms) * 100.0 / base->median_ms;
+
+    double se = 0;
+    if (now->runs) se += now->stddev_ms * now->stddev_ms / now->runs;
+    if (base->runs) se += base->stddev_ms * base->stddev_ms / base->runs;
+    bool significant = now->mean_ms - base->mean_ms > 2 * _bench_sqrt(se);
+    return *change > threshold && significant;
+}
+
+static long _bench_conf_long(ini_config *ini, const char *key, long def, long min, long max){
+    const char *v = ini_get_at(ini, "bench", key);
+    if (!v) return def;
+    long n = atol(v);
+    return n < min ? min : (n > max ? max : n);
+}
+
+/*
+ * Runs the [bench] binaries of an already built config. Returns the number
+ * of failed or regressed benchmarks, or -1 when there is nothing to run.
+ */
+int bench_run(ini_config *ini, const bench_opts *opts){
+    const char *list = ini_get_at(ini, "bench", "binaries");
+    if (!list){
+        fprintf(stderr, "%s[error]%s no [bench] binaries configured\n", abs_fore.red, abs_fore.normal);
+        return -1;
+    }
+    const char *args = ini_get_at(ini, "bench", "args");
+    long reps = _bench_conf_long(ini, "repetitions", 10, 1, ABS_BENCH_MAX_REPS);
+    long warmup = _bench_conf_long(ini, "warmup", 1, 0, ABS_BENCH_MAX_REPS);
+    long cpu = _bench_conf_long(ini, "cpu", -1, -1, CPU_SETSIZE - 1);
+    const char *threshold_str = ini_get_at(ini, "bench", "threshold");
+    double threshold = threshold_str ? strtod(threshold_str, NULL) : 5.0;
+
+    char **paths = NULL;
+    size_t paths_n = 0;
+    expand_sources(NULL, list, &paths, &paths_n);
+
+    char *obj_dir = config_obj_dir(ini);
+    char bench_dir[PATH_MAX], results_path[PATH_MAX + 16], baseline_path[PATH_MAX + 16];
+    snprintf(bench_dir, sizeof(bench_dir), "%s/bench", obj_dir);
+    snprintf(results_path, sizeof(results_path), "%s/results.json", bench_dir);
+    snprintf(baseline_path, sizeof(baseline_path), "%s/baseline.json", bench_dir);
+    free(obj_dir);
+    mkdir_p(bench_dir);
+
+    bench_set baseline;
+    const char *baseline_file = opts->baseline ? opts->baseline : baseline_path;
+    bool have_baseline = !opts->save_baseline && bench_load(&baseline, baseline_file) == 0;
+    if (opts->baseline && !have_baseline){
+        fprintf(stderr, "%s[error]%s cannot read baseline %s\n", abs_fore.red, abs_fore.normal, opts->baseline);
+        for (size_t i = 0; i < paths_n; i++) free(paths[i]);
+        free(paths);
+        return -1;
+    }
+
+    bench_set now = {0};
+    now.results = calloc(paths_n ? paths_n : 1, sizeof(bench_result));
+    double *samples = malloc(sizeof(double) * reps);
+    int failed = 0;
+
+    printf("%s[bench]%s %zu benchmarks, %ld runs each%s", abs_fore.blue, abs_fore.normal, paths_n, reps,
+           cpu >= 0 ? "" : "\n");
+    if (cpu >= 0) printf(", pinned to cpu %ld\n", cpu);
+
+    for (size_t i = 0; i < paths_n; i++){
+        const char *path = paths[i];
+        bench_result *r = &now.results[now.n++];
+        r->name = strdup(path);
+
+        char cmd[PATH_MAX * 2 + 64], log_path[PATH_MAX * 2 + 16], flat[PATH_MAX];
+        snprintf(flat, sizeof(flat), "%s", path);
+        for (char *p = flat; *p; p++) if (*p == '/') *p = '_';
+        snprintf(log_path, sizeof(log_path), "%s/%s.log", bench_dir, flat);
+        snprintf(cmd, sizeof(cmd), "exec \"%s%s\" %s", strchr(path, '/') ? "" : "./", path, args ? args : "");
+
+        int log_fd = open(log_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        size_t n = 0;
+        double cpu_total = 0;
+        for (long k = 0; k < warmup + reps && !r->failed; k++){
+            double cpu_ms = 0;
+            double ms = bench_run_once(cmd, (int)cpu, log_fd, &cpu_ms);
+            if (ms < 0) r->failed = true;
+            else if (k >= warmup){
+                samples[n++] = ms;
+                cpu_total += cpu_ms;
+            }
+        }
+        if (log_fd >= 0) close(log_fd);
+
+        if (r->failed){
+            printf("%s[bench]%s %s %sFAIL%s (see %s)\n", abs_fore.blue, abs_fore.normal, path,
+                   abs_fore.red, abs_fore.normal, log_path);
+            failed++;
+            continue;
+        }
+        bench_stats(r, samples, n);
+        r->cpu_ms = n ? cpu_total / n : 0;
+
+        printf("%s[bench]%s %s: median %.3f ms, mean %.3f ms +- %.3f, min %.3f, cpu %.3f ms",
+               abs_fore.blue, abs_fore.normal, path, r->median_ms, r->mean_ms, r->stddev_ms, r->min_ms, r->cpu_ms);
+
+        bench_result *base = have_baseline ? bench_find(&baseline, path) : NULL;
+        double change;
+        if (base && bench_regressed(r, base, threshold, &change)){
+            printf(" %s%+.1f%% REGRESSION%s\n", abs_fore.red, change, abs_fore.normal);
+            failed++;
+        } else if (base){
+            printf(" %s%+.1f%%%s\n", change < 0 ? abs_fore.green : abs_fore.gray, change, abs_fore.normal);
+        } else {
+            printf("\n");
+        }
+        fflush(stdout);
+    }
+
+    if (bench_save(&now, results_path, "release") != 0){
+        fprintf(stderr, "%s[error]%s cannot write %s\n", abs_fore.red, abs_fore.normal, results_path);
+    } else if (opts->save_baseline){
+        if (failed == 0 && _bench_copy(results_path, baseline_path) == 0)
+            printf("%s[bench]%s baseline saved to %s\n", abs_fore.blue, abs_fore.normal, baseline_path);
+        else
+            fprintf(stderr, "%s[error]%s baseline not saved\n", abs_fore.red, abs_fore.normal);
+    }
+
+    if (!have_baseline && !opts->save_baseline){
+        printf("%s[bench]%s no baseline; `abs bench --save-baseline` records one\n", abs_fore.blue, abs_fore.normal);
+    }
+    printf("%s[bench]%s %zu run, %d failed or regressed (threshold %.1f%%)\n", abs_fore.blue, abs_fore.normal,
+           now.n, failed, threshold);
+
+    free(samples);
+    bench_set_free(&now);
+    if (have_baseline) bench_set_free(&baseline);
+    for (size_t i = 0; i < paths_n; i++) free(paths[i]);
+    free(paths);
+    return failed;
+}
+
+#endif
+#define ABS_BENCH
@@ -1,5 +1,15 @@
 #include "configuration.h"
+#include "arena.h"
+#include "depscan.h"
+#include "modules.h"
+#include "variants.h"
+#include "shared.h"
+#include "generate.h"
+#include "archive.h"
+#include "executor.h"
+#include "jobs.h"
 #include <dirent.h>
+#include <fnmatch.h>
 #include <linux/limits.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -7,6 +17,48 @@
 
 #ifndef ABS_COMPILATION
 
+#define ABS_CMD_MAX 65536
+
+// creates `path` and any missing parents
+static int mkdir_p(const char *path) {
+    char buf[PATH_MAX];
+    snprintf(buf, sizeof(buf), "%s", path);
+
+    for (char *p = buf + 1; *p; p++) {
+        if (*p != '/') continue;
+        *p = '\0';
+        mkdir(buf, 0755);
+        *p = '/';
+    }
+
+    struct stat st;
+    if (stat(buf, &st) == 0 && S_ISDIR(st.st_mode)) return 0;
+    return mkdir(buf, 0755);
+}
+
+/*
+ * Where state that outlives a build (job durations, test results) is kept:
+ * the abs cache, under a directory named after the absolute `obj_dir`, so
+ * removing the objects directory never loses it and cleanup can.
+ */
+int abs_state_path(const char *obj_dir, const char *name, char *out, size_t out_sz) {
+    char cache[PATH_MAX], key[PATH_MAX * 2], cwd[PATH_MAX];
+    if (abs_cache_dir(cache, sizeof(cache)) != 0) return -1;
+
+    while (obj_dir[0] == '.' && obj_dir[1] == '/') obj_dir += 2;
+    if (obj_dir[0] == '/') snprintf(key, sizeof(key), "%s", obj_dir);
+    else if (getcwd(cwd, sizeof(cwd))) snprintf(key, sizeof(key), "%s/%s", cwd, obj_dir);
+    else return -1;
+    size_t len = strlen(key);
+    while (len > 1 && key[len - 1] == '/') key[--len] = '\0';
+
+    char dir[PATH_MAX + 32];
+    snprintf(dir, sizeof(dir), "%s/state/%016llx", cache, (unsigned long long)depscan_hash(key, len));
+    if (mkdir_p(dir) != 0) return -1;
+    snprintf(out, out_sz, "%s/%s", dir, name);
+    return 0;
+}
+
 static void _free_str_array(char ***arr, size_t *n) {
     if (!arr || !*arr) return;
     for (size_t i = 0; i < *n; i++) {
@@ -17,58 +69,60 @@ static void _free_str_array(char ***arr, size_t *n) {
     *n = 0;
 }
 
+/*
+ * What one planned build links. Paths are interned in `arena` and freed with
+ * it; `names` holds the object file names, which archive members are.
+ */
 typedef struct {
-    char **obj_paths;
+    const char **obj_paths;
     size_t obj_n;
-    char **src_paths;
+    const char **src_paths;
     size_t src_n;
+    char  *fresh;        // fresh[i] != 0 when obj_paths[i] is compiled in this run
+
+    abs_arena  arena;
+    abs_strtab paths;
+    abs_strtab names;
 } build_artifacts;
 
 static void _init_artifacts(build_artifacts *art) {
     if (!art) return;
-    art->obj_paths = NULL;
-    art->obj_n = 0;
-    art->src_paths = NULL;
-    art->src_n = 0;
+    memset(art, 0, sizeof(*art));
+    art->paths.arena = &art->arena;
+    art->names.arena = &art->arena;
 }
 
 static void _free_artifacts(build_artifacts *art) {
     if (!art) return;
-    _free_str_array(&art->obj_paths, &art->obj_n);
-    _free_str_array(&art->src_paths, &art->src_n);
-    art->src_n = 0;
-    art->obj_n = 0;
-    art->obj_paths = 0;
-    art->src_paths = 0;
+    free(art->obj_paths);
+    free(art->src_paths);
+    free(art->fresh);
+    strtab_free(&art->paths);
+    strtab_free(&art->names);
+    arena_free(&art->arena);
+    _init_artifacts(art);
 }
 
-static int _add_artifact(build_artifacts *art, const char *src, const char *obj) {
+static int _add_artifact(build_artifacts *art, const char *src, const char *obj, int fresh) {
     if (!art || !src || !obj) return -1;
-    
-    char **tmp_obj = realloc(art->obj_paths, sizeof(char*) * (art->obj_n + 1));
-    char **tmp_src = realloc(art->src_paths, sizeof(char*) * (art->src_n + 1));
-    
-    if (!tmp_obj || !tmp_src) {
-        free(tmp_obj);
-        free(tmp_src);
-        return -1;
-    }
-    
-    art->obj_paths = tmp_obj;
-    art->src_paths = tmp_src;
-    
-    art->obj_paths[art->obj_n] = strdup(obj);
-    art->src_paths[art->src_n] = strdup(src);
-    
-    if (!art->obj_paths[art->obj_n] || !art->src_paths[art->obj_n]) {
-        free(art->obj_paths[art->obj_n]);
-        free(art->src_paths[art->src_n]);
+
+    if (abs_grow(&art->obj_paths, art->obj_n, sizeof(char*)) != 0 ||
+        abs_grow(&art->src_paths, art->src_n, sizeof(char*)) != 0 ||
+        abs_grow(&art->fresh, art->obj_n, 1) != 0) {
         return -1;
     }
-    
+
+    const char *base = strrchr(obj, '/');
+    base = base ? base + 1 : obj;
+    const char *obj_i = strtab_intern(&art->paths, obj, strlen(obj));
+    const char *src_i = strtab_intern(&art->paths, src, strlen(src));
+    if (!obj_i || !src_i || !strtab_intern(&art->names, base, strlen(base))) return -1;
+
+    art->obj_paths[art->obj_n] = obj_i;
+    art->src_paths[art->src_n] = src_i;
+    art->fresh[art->obj_n] = (char)fresh;
     art->obj_n++;
     art->src_n++;
-    
     return 0;
 }
 
@@ -89,6 +143,70 @@ static size_t build_common_flags(const compiler_conf *cfg, char *out_buf, size_t
         pos += snprintf(out_buf + pos, out_sz - pos, 
             "$(pkg-config --cflags %s) ", cfg->pkg_config_libs[i]);
     }
+    for (size_t i = 0; i < cfg->prefix_maps_n; i++) {
+        pos += snprintf(out_buf + pos, out_sz - pos, "-ffile-prefix-map=%s=. ", cfg->prefix_maps[i]);
+    }
+    return pos;
+}
+
+static int has_debug_flag(const compiler_conf *cfg) {
+    for (size_t i = 0; i < cfg->cflags_n; i++) {
+        const char *f = cfg->cflags[i];
+        if (strncmp(f, "-g", 2) != 0) continue;
+        if (strcmp(f, "-g0") == 0 || strncmp(f, "-gz", 3) == 0 || strcmp(f, "-gsplit-dwarf") == 0)
+            continue;
+        return 1;
+    }
+    return 0;
+}
+
+static int is_split_debug(const compiler_conf *cfg) {
+    return cfg->debuginfo && strcmp(cfg->debuginfo, "split") == 0 && has_debug_flag(cfg);
+}
+
+// gcc and clang name the split DWARF file after the object: x.o -> x.dwo
+static void get_dwo_path(const char *obj_path, char *out, size_t out_sz) {
+    snprintf(out, out_sz, "%s", obj_path);
+    char *dot = strrchr(out, '.');
+    if (dot && strcmp(dot, ".o") == 0) *dot = '\0';
+    size_t len = strlen(out);
+    snprintf(out + len, out_sz - len, ".dwo");
+}
+
+// only with -g in the flags, a release build has no debug info to split or compress
+static size_t build_debuginfo_flags(const compiler_conf *cfg, char *out_buf, size_t out_sz, size_t pos) {
+    if (!cfg->debuginfo || !has_debug_flag(cfg)) return pos;
+    if (strcmp(cfg->debuginfo, "split") == 0) {
+        pos += snprintf(out_buf + pos, out_sz - pos, "-gsplit-dwarf ");
+    } else if (strcmp(cfg->debuginfo, "compressed") == 0) {
+        pos += snprintf(out_buf + pos, out_sz - pos, "-gz ");
+    }
+    return pos;
+}
+
+// flags only the link step needs: linker selection and compressed sections
+static size_t build_link_flags(const compiler_conf *cfg, char *out_buf, size_t out_sz, size_t pos) {
+    if (cfg->linker) {
+        pos += snprintf(out_buf + pos, out_sz - pos, "-fuse-ld=%s ", cfg->linker);
+    }
+    if (cfg->debuginfo && strcmp(cfg->debuginfo, "compressed") == 0 && has_debug_flag(cfg)) {
+        pos += snprintf(out_buf + pos, out_sz - pos, "-gz ");
+    }
+    return pos;
+}
+
+// extra flags from [flags.per_source]; globs without '/' also match the file name
+static size_t build_source_flags(const compiler_conf *cfg, const char *src, char *out_buf, size_t out_sz, size_t pos) {
+    const char *base = strrchr(src, '/');
+    base = base ? base + 1 : src;
+
+    for (size_t i = 0; i < cfg->src_flags_n; i++) {
+        const char *glob = cfg->src_flag_globs[i];
+        if (fnmatch(glob, src, FNM_PATHNAME) == 0 ||
+            (!strchr(glob, '/') && fnmatch(glob, base, 0) == 0)) {
+            pos += snprintf(out_buf + pos, out_sz - pos, "%s ", cfg->src_flag_values[i]);
+        }
+    }
     return pos;
 }
 
@@ -107,10 +225,64 @@ static size_t build_ldlibs(const compiler_conf *cfg, char *out_buf, size_t out_s
     return pos;
 }
 
-static int needs_rebuild(const char *src_path, const char *obj_path) {
+// the abs executable job commands call back into
+static int abs_self(const compiler_conf *cfg, char *out, size_t out_sz) {
+    if (cfg->self_path && !*cfg->self_path) return -1;
+    if (cfg->self_path) {
+        snprintf(out, out_sz, "%s", cfg->self_path);
+        return 0;
+    }
+    return executor_self_path(out, out_sz);
+}
+
+/*
+ * `abs --restat NEW OUTPUT`, the last step of compiles and links. NEW
+ * replaces OUTPUT unless both are byte-identical, in which case OUTPUT
+ * stays as it was, mtime included, and everything depending on it is
+ * still up to date. Ninja calls this restat.
+ */
+int restat_output(const char *tmp_path, const char *out_path) {
+    struct stat tmp_st, out_st;
+    if (stat(tmp_path, &tmp_st) != 0) return -1;
+
+    int same = 0;
+    if (stat(out_path, &out_st) == 0 && out_st.st_size == tmp_st.st_size) {
+        size_t a_len = 0, b_len = 0;
+        char *a = exec_read_file(tmp_path, &a_len);
+        char *b = a ? exec_read_file(out_path, &b_len) : NULL;
+        same = a && b && a_len == b_len && memcmp(a, b, a_len) == 0;
+        free(a);
+        free(b);
+    }
+
+    if (same) {
+        printf("%s[restat]%s %s unchanged\n", abs_fore.cyan, abs_fore.normal, out_path);
+        return unlink(tmp_path);
+    }
+    return rename(tmp_path, out_path);
+}
+
+/*
+ * When an object was last compiled. With restat the object keeps an old
+ * mtime after an identical recompile, but its signature is rewritten by
+ * every compile, so the newer of the two is the time sources and headers
+ * are compared against.
+ */
+static time_t object_built_at(const char *obj_path, const struct stat *obj_st) {
+    char sig_path[PATH_MAX + 8];
+    struct stat sig_st;
+    snprintf(sig_path, sizeof(sig_path), "%s.sig", obj_path);
+    if (stat(sig_path, &sig_st) == 0 && sig_st.st_mtime > obj_st->st_mtime) return sig_st.st_mtime;
+    return obj_st->st_mtime;
+}
+
+// fills `why` with the reason when the object is stale
+static int needs_rebuild(const compiler_conf *cfg, const char *src_path, const char *obj_path,
+                         char *why, size_t why_sz) {
     struct stat src_st, obj_st;
     
     if (stat(obj_path, &obj_st) != 0) {
+        snprintf(why, why_sz, "object missing");
         return 1;
     }
     
@@ -120,15 +292,102 @@ static int needs_rebuild(const char *src_path, const char *obj_path) {
         return 0;
     }
     
-    if (src_st.st_mtime > obj_st.st_mtime) {
+    time_t built = object_built_at(obj_path, &obj_st);
+    if (src_st.st_mtime > built) {
+        snprintf(why, why_sz, "source newer than object");
         return 1;
     }
-    
+
+    depscan_deps deps;
+    const char *header = depscan_newer_header(cfg, src_path, built, &deps);
+    if (header) {
+        printf("%s[deps]%s %s changed\n", abs_fore.magenta, abs_fore.normal, header);
+        snprintf(why, why_sz, "header %s newer than object", header);
+    }
+    int stale = header != NULL;
+    depscan_deps_free(&deps);
+
+    return stale;
+}
+
+/*
+ * Every object keeps a signature (hash of the exact command that produced
+ * it) next to it, written only after a successful compile. A changed
+ * compiler, flag, define or per-source override changes the signature.
+ */
+static void get_sig_path(const char *obj_path, char *out, size_t out_sz) {
+    snprintf(out, out_sz, "%s.sig", obj_path);
+}
+
+static int signature_changed(const char *obj_path, uint64_t sig) {
+    char sig_path[PATH_MAX];
+    get_sig_path(obj_path, sig_path, sizeof(sig_path));
+
+    FILE *f = fopen(sig_path, "r");
+    if (!f) return 1;
+
+    unsigned long long stored = 0;
+    int ok = fscanf(f, "%llx", &stored) == 1;
+    fclose(f);
+
+    return !ok || stored != (unsigned long long)sig;
+}
+
+/*
+ * The command of the last compile planned for an object is kept in
+ * `<object>.cmd`, so a changed signature can be explained argument by
+ * argument. Arguments are compared as whitespace separated words.
+ */
+static void get_cmd_path(const char *obj_path, char *out, size_t out_sz) {
+    snprintf(out, out_sz, "%s.cmd", obj_path);
+}
+
+static int _has_word(char **words, size_t n, const char *w) {
+    for (size_t i = 0; i < n; i++) {
+        if (strcmp(words[i], w) == 0) return 1;
+    }
     return 0;
 }
 
+static void explain_command_change(const char *obj_path, const char *cmd, char *why, size_t why_sz) {
+    char cmd_path[PATH_MAX + 8];
+    get_cmd_path(obj_path, cmd_path, sizeof(cmd_path));
+
+    size_t old_len = 0;
+    char *old = exec_read_file(cmd_path, &old_len);
+    if (!old) {
+        snprintf(why, why_sz, "command changed (no earlier command recorded)");
+        return;
+    }
+    if (strcmp(old, cmd) == 0) {
+        snprintf(why, why_sz, "signature missing (last compile failed or was interrupted)");
+        free(old);
+        return;
+    }
+
+    size_t old_n = 0, new_n = 0;
+    char **old_words = _str_split(old, ' ', &old_n);
+    char **new_words = _str_split(cmd, ' ', &new_n);
+    size_t pos = snprintf(why, why_sz, "command changed");
+    size_t removed = 0, added = 0;
+    for (size_t i = 0; i < old_n && pos < why_sz; i++) {
+        if (_has_word(new_words, new_n, old_words[i])) continue;
+        pos += snprintf(why + pos, why_sz - pos, "%s %s", removed++ ? "" : ", removed", old_words[i]);
+    }
+    for (size_t i = 0; i < new_n && pos < why_sz; i++) {
+        if (_has_word(old_words, old_n, new_words[i])) continue;
+        pos += snprintf(why + pos, why_sz - pos, "%s %s", added++ ? "" : ", added", new_words[i]);
+    }
+    if (removed + added == 0) snprintf(why, why_sz, "command changed, same arguments in another order");
+
+    _free_str_array(&old_words, &old_n);
+    _free_str_array(&new_words, &new_n);
+    free(old);
+}
+
 static const char *src_extensions[] = {
     ".cpp", ".cxx", ".cc", ".C", ".CPP",  /* C++ */
+    ".cppm", ".ixx",                      /* C++ module interfaces */
     ".c", ".h", ".hpp", ".hxx",           /* C/C++ headers */
     NULL
 };
@@ -145,6 +404,8 @@ static const char *get_ext_prefix(const char *filename) {
             if (strcmp(ext, ".cpp") == 0 || strcmp(ext, ".CPP") == 0) return "cpp";
             if (strcmp(ext, ".cxx") == 0 || strcmp(ext, ".CXX") == 0) return "cxx";
             if (strcmp(ext, ".cc") == 0 || strcmp(ext, ".CC") == 0) return "cc";
+            if (strcmp(ext, ".cppm") == 0) return "cppm";
+            if (strcmp(ext, ".ixx") == 0) return "ixx";
             if (strcmp(ext, ".c") == 0 || strcmp(ext, ".C") == 0) return "c";
             if (strcmp(ext, ".h") == 0 || strcmp(ext, ".H") == 0) return "h";
             if (strcmp(ext, ".hpp") == 0 || strcmp(ext, ".HPP") == 0) return "hpp";
@@ -179,18 +440,406 @@ static void get_obj_path(const compiler_conf *cfg, const char *src, char *out, s
     snprintf(out, out_sz, "%s/%s_%s.o", cfg->obj_dir, prefix, clean);
 }
 
-int build_config_emit_cmd(int force_recompile, const compiler_conf *cfg, char *out_buf, size_t out_sz) {
-    size_t pos = 0;
+/*
+ * Packages the .dwo files of a split-debug link into `<output>.dwp`. The
+ * .dwo files are listed explicitly instead of using `dwp -e`, which has to
+ * read them back through the linked binary's skeleton units.
+ */
+static size_t build_dwp_cmd(const compiler_conf *cfg, const build_artifacts *art, const char *output,
+                            char *out_buf, size_t out_sz, size_t pos) {
+    if (!cfg->dwp || !is_split_debug(cfg)) return pos;
+
+    pos += snprintf(out_buf + pos, out_sz - pos, "&& dwp -o \"%s.dwp\" ", output);
+    for (size_t i = 0; i < art->obj_n; i++) {
+        char dwo_path[PATH_MAX];
+        get_dwo_path(art->obj_paths[i], dwo_path, sizeof(dwo_path));
+        pos += snprintf(out_buf + pos, out_sz - pos, "\"%s\" ", dwo_path);
+    }
+    return pos;
+}
+
+// `label [mode]` when several modes share one job list
+static const char *job_label(const compiler_conf *cfg, const char *label, char *buf, size_t buf_sz) {
+    if (!cfg->mode_tag) return label;
+    snprintf(buf, buf_sz, "%s [%s]", label, cfg->mode_tag);
+    return buf;
+}
+
+/*
+ * Adds the compile job of one object unless it is up to date. `extra` flags
+ * go after the common and per-source ones and are part of the signature;
+ * `stale_reason`, when set, forces a rebuild for a reason tracked by the caller.
+ * Returns the job index, or -1 when the object is up to date.
+ */
+static long emit_object(int force_recompile, const compiler_conf *cfg, const char *label,
+                        const char *src, const char *src_full_path, const char *obj_path,
+                        const char *extra, const char *stale_reason, job_list *jobs) {
+    char obj_cmd[8192], tagged[PATH_MAX + 160];
+    size_t cpos = 0;
+    label = job_label(cfg, label, tagged, sizeof(tagged));
+
+    cpos += snprintf(obj_cmd + cpos, sizeof(obj_cmd) - cpos, "%s ", cfg->compiler);
+
+    if (cfg->build_type && strcmp(cfg->build_type, "shared") == 0) {
+        cpos += snprintf(obj_cmd + cpos, sizeof(obj_cmd) - cpos, "-fPIC ");
+    }
+    cpos = build_shared_cflags(cfg, obj_cmd, sizeof(obj_cmd), cpos);
+
+    cpos = build_common_flags(cfg, obj_cmd, sizeof(obj_cmd), cpos);
+    cpos = build_source_flags(cfg, src, obj_cmd, sizeof(obj_cmd), cpos);
+    cpos = build_debuginfo_flags(cfg, obj_cmd, sizeof(obj_cmd), cpos);
+    // names GCC makes up (anonymous namespaces, LTO sections) follow the object, not a random seed
+    if (cfg->reproducible) {
+        cpos += snprintf(obj_cmd + cpos, sizeof(obj_cmd) - cpos, "-frandom-seed=%s ", obj_path);
+    }
+    if (extra && *extra) {
+        cpos += snprintf(obj_cmd + cpos, sizeof(obj_cmd) - cpos, "%s", extra);
+    }
+    size_t flags_end = cpos;
+    cpos += snprintf(obj_cmd + cpos, sizeof(obj_cmd) - cpos, "-c ");
+    cpos += snprintf(obj_cmd + cpos, sizeof(obj_cmd) - cpos, "\"%s\" -o \"%s\" ",
+                     src_full_path, obj_path);
+
+    char sig_path[PATH_MAX], log_path[PATH_MAX + 8];
+    get_sig_path(obj_path, sig_path, sizeof(sig_path));
+    snprintf(log_path, sizeof(log_path), "%s.log", obj_path);
+
+    uint64_t sig = depscan_hash(obj_cmd, cpos);
+    double scan_started = stats_now_ms();
+    // a failed compile removes its signature and leaves the previous object
+    int obj_exists = !force_recompile && access(obj_path, F_OK) == 0;
+    int last_failed = obj_exists && access(sig_path, F_OK) != 0;
+    int flags_changed = obj_exists && !last_failed && signature_changed(obj_path, sig);
+
+    char dwo_path[PATH_MAX];
+    get_dwo_path(obj_path, dwo_path, sizeof(dwo_path));
+    int dwo_missing = is_split_debug(cfg) && access(dwo_path, F_OK) != 0;
+
+    char why[PATH_MAX + 256] = "";
+    int stale = 1;
+    if (force_recompile) snprintf(why, sizeof(why), "forced with -r");
+    else if (last_failed) snprintf(why, sizeof(why), "last compile failed");
+    else if (flags_changed) {
+        obj_cmd[cpos] = '\0';
+        if (cfg->explain) explain_command_change(obj_path, obj_cmd, why, sizeof(why));
+        else snprintf(why, sizeof(why), "command changed");
+    }
+    else if (stale_reason) snprintf(why, sizeof(why), "%s", stale_reason);
+    else if (dwo_missing) snprintf(why, sizeof(why), "split debug info missing");
+    else stale = needs_rebuild(cfg, src_full_path, obj_path, why, sizeof(why));
+    abs_stats.scan_ms += stats_now_ms() - scan_started;
+    if (!stale) {
+        if (!cfg->progress) printf("%s[skip]%s %s (up to date)\n", abs_fore.cyan, abs_fore.normal, label);
+        abs_stats.up_to_date++;
+        return -1;
+    }
+    abs_stats.compiled++;
+
+    if (cfg->explain || flags_changed || last_failed) {
+        printf("%s[compile]%s %s (%s)\n", abs_fore.green, abs_fore.normal, label, why);
+    } else if (!cfg->progress) {
+        printf("%s[compile]%s %s\n", abs_fore.green, abs_fore.normal, label);
+    }
+
+    char cmd_path[PATH_MAX + 8];
+    get_cmd_path(obj_path, cmd_path, sizeof(cmd_path));
+    if (!cfg->dry_run) exec_write_file(cmd_path, obj_cmd, cpos);
+
+    char self[PATH_MAX];
+    int have_self = abs_self(cfg, self, sizeof(self)) == 0;
+
+    // with split debug info the .dwo name follows the -o name, so those compile in place
+    int restat = cfg->restat && have_self && !is_split_debug(cfg);
+    char target[PATH_MAX + 8];
+    snprintf(target, sizeof(target), restat ? "%s.tmp" : "%s", obj_path);
+
+    // profiling flags stay out of the signature, the next plain build reuses these objects
+    if (cfg->profile) {
+        const char *pflag = is_clang(cfg) ? "-ftime-trace " : "-ftime-report ";
+        cpos = flags_end + snprintf(obj_cmd + flags_end, sizeof(obj_cmd) - flags_end, "%s-c \"%s\" -o \"%s\" ",
+                                    pflag, src_full_path, target);
+        flags_end += strlen(pflag);
+    }
+
+    // the signature stays that of the local command, so switching executors never rebuilds
+    if (cfg->workers_n && !cfg->profile && !is_split_debug(cfg) && !(extra && strstr(extra, "-fmodule")) && have_self) {
+        char flags[8192];
+        snprintf(flags, sizeof(flags), "%.*s", (int)flags_end, obj_cmd);
+        cpos = snprintf(obj_cmd, sizeof(obj_cmd),
+                        "%s-E \"%s\" -o \"%s.i\" && \"%s\" --remote-cc \"%s.i\" \"%s\" -- %s-c -x %s "
+                        "&& rm -f \"%s.i\" ",
+                        flags, src_full_path, obj_path, self, obj_path, target, flags,
+                        is_cxx_source(src_full_path) ? "c++-cpp-output" : "cpp-output", obj_path);
+    } else if (restat) {
+        cpos = flags_end;
+        cpos += snprintf(obj_cmd + cpos, sizeof(obj_cmd) - cpos, "-c \"%s\" -o \"%s\" ",
+                         src_full_path, target);
+    }
+    if (cfg->profile && !is_clang(cfg)) {
+        // the report goes to OBJECT.time, the diagnostics before it stay in the job's output
+        char compile[8192];
+        snprintf(compile, sizeof(compile), "%.*s", (int)cpos, obj_cmd);
+        cpos = snprintf(obj_cmd, sizeof(obj_cmd),
+                        "( %s2> \"%s.time\"; r=$?; sed -e '/^Time variable/,$d' -e '/^$/d' \"%s.time\" >&2; exit $r ) ",
+                        compile, obj_path, obj_path);
+    }
+    if (restat) {
+        cpos += snprintf(obj_cmd + cpos, sizeof(obj_cmd) - cpos, "&& \"%s\" --restat \"%s\" \"%s\" ",
+                         self, target, obj_path);
+    }
+
+    cpos += snprintf(obj_cmd + cpos, sizeof(obj_cmd) - cpos, "&& echo %016llx > \"%s\" ",
+                     (unsigned long long)sig, sig_path);
+
+    long job = jobs_add(jobs, JOB_COMPILE, label, obj_cmd, log_path, sig_path);
+    if (job >= 0 && restat) jobs_restat(jobs, job, obj_path);
+    return job;
+}
+
+/*
+ * A module unit is stale when its BMI is missing or when any module it
+ * imports was rebuilt in this run or has a BMI newer than its object.
+ */
+static int module_needs_rebuild(const compiler_conf *cfg, const module_info *minfo, size_t n,
+                                size_t idx, const char *rebuilt, const char *obj_path) {
+    struct stat obj_st, bmi_st;
+    char bmi[PATH_MAX];
+
+    if (stat(obj_path, &obj_st) != 0) return 1;
+
+    if (minfo[idx].provides) {
+        module_bmi_path(cfg, minfo[idx].provides, bmi, sizeof(bmi));
+        if (stat(bmi, &bmi_st) != 0) return 1;
+    }
+
+    for (size_t r = 0; r < minfo[idx].requires_n; r++) {
+        long dep = modules_provider(minfo, n, minfo[idx].requires[r]);
+        if (dep < 0) continue;
+        if (rebuilt[dep]) return 1;
+
+        module_bmi_path(cfg, minfo[idx].requires[r], bmi, sizeof(bmi));
+        if (stat(bmi, &bmi_st) != 0 || bmi_st.st_mtime > object_built_at(obj_path, &obj_st)) {
+            printf("%s[deps]%s module %s changed\n", abs_fore.magenta, abs_fore.normal,
+                   minfo[idx].requires[r]);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void get_variant_obj_path(const compiler_conf *cfg, const char *src, const char *suffix,
+                                 char *out, size_t out_sz) {
+    char obj_path[PATH_MAX];
+    get_obj_path(cfg, src, obj_path, sizeof(obj_path));
+    snprintf(out, out_sz, "%s/%s_%s", cfg->obj_dir, suffix, obj_path + strlen(cfg->obj_dir) + 1);
+}
+
+/*
+ * Compiles [variants] sources per level plus the generated ifunc dispatcher.
+ * Returns whether anything compiles, or -1 when a C++ source lacks C linkage.
+ */
+static int emit_variants(int force_recompile, const compiler_conf *cfg, build_artifacts *art, job_list *jobs) {
+    if (cfg->variant_sources_n == 0) return 0;
+    if (variants_check_linkage(cfg) != 0) return -1;
+
+    int compiled = 0;
+    for (size_t i = 0; i < cfg->variant_sources_n; i++) {
+        const char *src = cfg->variant_sources[i];
+        char src_full_path[PATH_MAX];
+        snprintf(src_full_path, sizeof(src_full_path), "%s/%s", cfg->src_dir, src);
+
+        for (size_t l = 0; l <= cfg->variant_levels_n; l++) {
+            const char *level = l == 0 ? NULL : cfg->variant_levels[l - 1];
+            char suffix[128], obj_path[PATH_MAX], label[PATH_MAX + 128];
+            char extra[4096] = {0};
+
+            variant_suffix(level ? level : "base", suffix, sizeof(suffix));
+            get_variant_obj_path(cfg, src, suffix, obj_path, sizeof(obj_path));
+            snprintf(label, sizeof(label), "%s [%s]", src, level ? level : "base");
+            build_variant_flags(cfg, level, extra, sizeof(extra), 0);
+
+            int fresh = emit_object(force_recompile, cfg, label, src, src_full_path, obj_path,
+                                    extra, NULL, jobs) >= 0;
+            _add_artifact(art, src_full_path, obj_path, fresh);
+            compiled |= fresh;
+        }
+    }
+
+    char disp_src[PATH_MAX], disp_obj[PATH_MAX];
+    snprintf(disp_src, sizeof(disp_src), "%s/abs_dispatch.c", cfg->obj_dir);
+    snprintf(disp_obj, sizeof(disp_obj), "%s/abs_dispatch.o", cfg->obj_dir);
+    if (!cfg->dry_run && variants_write_dispatcher(cfg, disp_src) != 0) {
+        fprintf(stderr, "%s[error]%s failed to write variant dispatcher\n",
+                abs_fore.red, abs_fore.normal);
+        return compiled;
+    }
+
+    // C even for g++/clang++, see variants.h
+    compiler_conf disp;
+    if (variants_dispatcher_conf(cfg, &disp) != 0) return -1;
+    int fresh = emit_object(force_recompile, &disp, "[variants] dispatcher", "abs_dispatch.c",
+                            disp_src, disp_obj, "-x c ", NULL, jobs) >= 0;
+    free(disp.cflags);
+    _add_artifact(art, disp_src, disp_obj, fresh);
+    compiled |= fresh;
+    return compiled;
+}
+
+/*
+ * The quoted objects of a link or archive, those with `only[i]` set when
+ * given. A list too long for the command goes to `<objects>/link.rsp`,
+ * passed as `@file`, which both the compiler driver and ar expand.
+ */
+static size_t build_object_list(const compiler_conf *cfg, const build_artifacts *art, const char *only,
+                                char *out_buf, size_t out_sz, size_t pos) {
+    size_t len = 0;
+    for (size_t i = 0; i < art->obj_n; i++) {
+        if (!only || only[i]) len += strlen(art->obj_paths[i]) + 3;
+    }
+    if (pos + len < out_sz / 2) {
+        for (size_t i = 0; i < art->obj_n; i++) {
+            if (only && !only[i]) continue;
+            pos += snprintf(out_buf + pos, out_sz - pos, "\"%s\" ", art->obj_paths[i]);
+        }
+        return pos;
+    }
+
+    char rsp_path[PATH_MAX + 16];
+    snprintf(rsp_path, sizeof(rsp_path), "%s/link.rsp", cfg->obj_dir);
+    FILE *f = cfg->dry_run ? NULL : fopen(rsp_path, "w");
+    for (size_t i = 0; f && i < art->obj_n; i++) {
+        if (only && !only[i]) continue;
+        fputc('"', f);
+        for (const char *p = art->obj_paths[i]; *p; p++) {
+            if (*p == '"' || *p == '\\') fputc('\\', f);
+            fputc(*p, f);
+        }
+        fputs("\"\n", f);
+    }
+    if (f) fclose(f);
+    return pos + snprintf(out_buf + pos, out_sz - pos, "@\"%s\" ", rsp_path);
+}
+
+// the archive is missing, of the other kind, or holds objects no longer built
+static int archive_needs_rewrite(const compiler_conf *cfg, const build_artifacts *art, const char *lib_path) {
+    ar_index idx;
+    if (ar_read_index(lib_path, &idx) != 0) return 1;
+
+    int rewrite = idx.thin != cfg->thin_archive;
+    for (size_t m = 0; !rewrite && m < idx.members_n; m++) {
+        if (!strtab_find(&art->names, idx.members[m])) rewrite = 1;
+    }
+
+    ar_index_free(&idx);
+    return rewrite;
+}
+
+/*
+ * Static libraries are updated in place: only objects compiled in this run
+ * or newer than the archive are replaced (`ar r`). The archive is rewritten
+ * from scratch when it is missing, when its kind (thin/regular) changed or
+ * when it holds members that are no longer part of the build.
+ */
+static size_t build_archive_cmd(const compiler_conf *cfg, const build_artifacts *art, const char *lib_path,
+                                char *out_buf, size_t out_sz, size_t pos) {
+    // D: zero timestamps, uids and modes in member headers
+    const char *mode = cfg->thin_archive ? (cfg->reproducible ? "rcsTD" : "rcsT")
+                                         : (cfg->reproducible ? "rcsD" : "rcs");
+
+    ar_index idx;
+    struct stat lib_st;
+    int full = archive_needs_rewrite(cfg, art, lib_path) || ar_read_index(lib_path, &idx) != 0 ||
+               stat(lib_path, &lib_st) != 0;
+    if (full) memset(&idx, 0, sizeof(idx));
+
+    // members by name, so the check stays linear for large libraries
+    abs_arena members_arena = {0};
+    abs_strtab members = { .arena = &members_arena };
+    for (size_t m = 0; !full && m < idx.members_n; m++) {
+        strtab_intern(&members, idx.members[m], strlen(idx.members[m]));
+    }
+
+    size_t changed = 0;
+    char *update = calloc(art->obj_n ? art->obj_n : 1, 1);
+    for (size_t i = 0; !full && update && i < art->obj_n; i++) {
+        struct stat obj_st;
+        const char *base = strrchr(art->obj_paths[i], '/');
+        if (art->fresh[i] || !strtab_find(&members, base ? base + 1 : art->obj_paths[i]) ||
+            stat(art->obj_paths[i], &obj_st) != 0 || obj_st.st_mtime > lib_st.st_mtime) {
+            update[i] = 1;
+            changed++;
+        }
+    }
+    if (!update || changed == 0) full = 1;
+    strtab_free(&members);
+    arena_free(&members_arena);
+    ar_index_free(&idx);
+
+    if (full) {
+        pos += snprintf(out_buf + pos, out_sz - pos, "rm -f \"%s\" && ar %s \"%s\" ", lib_path, mode, lib_path);
+    } else {
+        printf("%s[ar]%s updating %zu of %zu members\n", abs_fore.blue, abs_fore.normal, changed, art->obj_n);
+        pos += snprintf(out_buf + pos, out_sz - pos, "ar %s \"%s\" ", mode, lib_path);
+    }
+
+    pos = build_object_list(cfg, art, full ? NULL : update, out_buf, out_sz, pos);
+
+    free(update);
+    return pos;
+}
+
+// `&& abs --restat TMP OUTPUT`, nothing without an abs executable
+static size_t build_restat_cmd(const char *self, const char *tmp, const char *output,
+                               char *out_buf, size_t out_sz, size_t pos) {
+    if (!self) return pos;
+    return pos + snprintf(out_buf + pos, out_sz - pos, "&& \"%s\" --restat \"%s\" \"%s\" ", self, tmp, output);
+}
+
+/*
+ * The first [dependencies] library found in the library directories that
+ * is newer than `since`, e.g. one a module just rebuilt. Libraries outside
+ * the configured directories belong to the system and are not checked.
+ */
+static int newer_dependency_lib(const compiler_conf *cfg, time_t since, char *out, size_t out_sz) {
+    static const char *exts[] = { "a", "so", NULL };
+    for (size_t l = 0; l < cfg->ldlibs_n; l++) {
+        for (size_t d = 0; d < cfg->lib_dirs_n; d++) {
+            for (int e = 0; exts[e]; e++) {
+                struct stat st;
+                snprintf(out, out_sz, "%s/lib%s.%s", cfg->lib_dirs[d], cfg->ldlibs[l], exts[e]);
+                if (stat(out, &st) == 0 && st.st_mtime > since) return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+// the final binary or library this config produces
+void get_output_path(const compiler_conf *cfg, char *out, size_t out_sz) {
+    int is_library = (cfg->build_type && 
+                     (strcmp(cfg->build_type, "static") == 0 || 
+                      strcmp(cfg->build_type, "shared") == 0));
+    if (is_library) {
+        snprintf(out, out_sz, "%s/%slib%s.%s", 
+                cfg->out_dir, 
+                cfg->output ? "" : "lib", 
+                cfg->output,
+                strcmp(cfg->build_type, "static") == 0 ? "a" : "so");
+    } else {
+        snprintf(out, out_sz, "%s/%s", cfg->out_dir, cfg->output);
+    }
+}
+
+/*
+ * Plans the build of one config: a compile job per out-of-date object and a
+ * link job depending on all of them. Nothing is run here.
+ */
+int build_config_emit_jobs(int force_recompile, const compiler_conf *cfg, job_list *jobs) {
     build_artifacts artifacts;
     _init_artifacts(&artifacts);
     
-    struct stat st = {0};
-    if (cfg->obj_dir && stat(cfg->obj_dir, &st) == -1) {
-        mkdir(cfg->obj_dir, 0755);
-    }
-    if (cfg->out_dir && stat(cfg->out_dir, &st) == -1) {
-        mkdir(cfg->out_dir, 0755);
-    }
+    if (cfg->obj_dir && !cfg->dry_run) mkdir_p(cfg->obj_dir);
+    if (cfg->out_dir && !cfg->dry_run) mkdir_p(cfg->out_dir);
     
     int is_library = (cfg->build_type && 
                      (strcmp(cfg->build_type, "static") == 0 || 
@@ -200,55 +849,119 @@ int build_config_emit_cmd(int force_recompile, const compiler_conf *cfg, char *o
     int phase_compile = (strcmp(phase, "compile") == 0 || strcmp(phase, "all") == 0);
     int phase_link = (strcmp(phase, "link") == 0 || strcmp(phase, "all") == 0);
     
-    int cmd_started = 0;
     int any_compiled = 0;
     int need_link = 0;
     
-    if (cfg->pkg_config_path) {
-        pos += snprintf(out_buf + pos, out_sz - pos, 
-            "PKG_CONFIG_PATH=%s ", cfg->pkg_config_path);
+    jobs_setenv(jobs, "PKG_CONFIG_PATH", cfg->pkg_config_path);
+    if (cfg->reproducible) {
+        // __DATE__ and __TIME__ come from here; an explicit value from the caller is kept
+        const char *epoch = getenv("SOURCE_DATE_EPOCH");
+        jobs_setenv(jobs, "SOURCE_DATE_EPOCH", epoch && *epoch ? epoch : "0");
+    }
+    if (cfg->workers_n) {
+        char workers[4096];
+        size_t wpos = 0;
+        for (size_t i = 0; i < cfg->workers_n && wpos < sizeof(workers); i++) {
+            wpos += snprintf(workers + wpos, sizeof(workers) - wpos, "%s%s", i ? " " : "", cfg->workers[i]);
+        }
+        jobs_setenv(jobs, "ABS_WORKERS", workers);
     }
     
 
+    module_info *minfo = NULL;
+    size_t *order = NULL;
+    char *rebuilt = NULL;
+    long *job_of = NULL;
+    int uses_modules = 0;
+    size_t first_job = jobs->n;
+    gen_plan gen = {0};
+    int r = 0;
+
     if (phase_compile) {
+        minfo = calloc(cfg->sources_n ? cfg->sources_n : 1, sizeof(module_info));
+        order = malloc(sizeof(size_t) * (cfg->sources_n ? cfg->sources_n : 1));
+        rebuilt = calloc(cfg->sources_n ? cfg->sources_n : 1, 1);
+        job_of = malloc(sizeof(long) * (cfg->sources_n ? cfg->sources_n : 1));
+        if (!minfo || !order || !rebuilt || !job_of) {
+            free(minfo); free(order); free(rebuilt); free(job_of);
+            _free_artifacts(&artifacts);
+            return -1;
+        }
+        if (generate_emit_jobs(force_recompile, cfg, jobs, &gen) != 0) {
+            free(minfo); free(order); free(rebuilt); free(job_of);
+            generate_plan_free(&gen);
+            _free_artifacts(&artifacts);
+            return -1;
+        }
+
         for (size_t i = 0; i < cfg->sources_n; i++) {
+            char src_full_path[PATH_MAX];
+            snprintf(src_full_path, sizeof(src_full_path), "%s/%s", cfg->src_dir, cfg->sources[i]);
+            order[i] = i;
+            job_of[i] = -1;
+            if (!is_cxx_source(src_full_path)) continue;
+
+            modules_scan(src_full_path, &minfo[i]);
+            if (minfo[i].provides || minfo[i].requires_n) uses_modules = 1;
+        }
+
+        if (uses_modules) {
+            if (modules_order(minfo, cfg->sources_n, order) != 0) {
+                for (size_t i = 0; i < cfg->sources_n; i++) module_info_free(&minfo[i]);
+                free(minfo); free(order); free(rebuilt); free(job_of);
+                generate_plan_free(&gen);
+                _free_artifacts(&artifacts);
+                return -1;
+            }
+            if (!cfg->dry_run) modules_write_mapper(cfg, minfo, cfg->sources_n);
+        }
+
+        for (size_t k = 0; k < cfg->sources_n; k++) {
+            size_t i = order[k];
             const char *src = cfg->sources[i];
+            if (is_variant_source(cfg, src)) continue;
             char obj_path[PATH_MAX];
             char src_full_path[PATH_MAX];
             
             get_obj_path(cfg, src, obj_path, sizeof(obj_path));
             snprintf(src_full_path, sizeof(src_full_path), "%s/%s", cfg->src_dir, src);
             
-            if (!force_recompile && !needs_rebuild(src_full_path, obj_path)) {
-                printf("%s[skip]%s %s (up to date)\n", 
-                       abs_fore.cyan, abs_fore.normal, src);
-                _add_artifact(&artifacts, src_full_path, obj_path);
-                continue;
+            char extra[PATH_MAX * 2] = {0}, gen_why[PATH_MAX + 64];
+            const char *stale_reason = NULL;
+            if (uses_modules && is_cxx_source(src_full_path)) {
+                build_module_flags(cfg, &minfo[i], src_full_path, extra, sizeof(extra), 0);
+                if (module_needs_rebuild(cfg, minfo, cfg->sources_n, i, rebuilt, obj_path))
+                    stale_reason = "imported module changed";
             }
-            
-            printf("%s[compile]%s %s\n", 
-                   abs_fore.green, abs_fore.normal, src);
-            
+            if (!stale_reason && generate_depend(cfg, &gen, src_full_path, jobs, -1, gen_why, sizeof(gen_why)))
+                stale_reason = gen_why;
 
-            if (cmd_started) {
-                pos += snprintf(out_buf + pos, out_sz - pos, "&& ");
+            job_of[i] = emit_object(force_recompile, cfg, src, src, src_full_path, obj_path,
+                                    extra, stale_reason, jobs);
+            if (job_of[i] < 0) {
+                _add_artifact(&artifacts, src_full_path, obj_path, 0);
+                continue;
             }
-            
-            pos += snprintf(out_buf + pos, out_sz - pos, "%s ", cfg->compiler);
-            
-            if (is_library && strcmp(cfg->build_type, "shared") == 0) {
-                pos += snprintf(out_buf + pos, out_sz - pos, "-fPIC ");
+            generate_depend(cfg, &gen, src_full_path, jobs, job_of[i], NULL, 0);
+
+            // importers wait for the BMIs of the modules they use
+            for (size_t r = 0; uses_modules && r < minfo[i].requires_n; r++) {
+                long dep = modules_provider(minfo, cfg->sources_n, minfo[i].requires[r]);
+                if (dep >= 0 && job_of[dep] >= 0) jobs_depend(jobs, job_of[i], job_of[dep]);
             }
-            
-            pos = build_common_flags(cfg, out_buf, out_sz, pos);
-            pos += snprintf(out_buf + pos, out_sz - pos, "-c ");
-            pos += snprintf(out_buf + pos, out_sz - pos, "\"%s\" -o \"%s\" ", 
-                           src_full_path, obj_path);
-            
-            _add_artifact(&artifacts, src_full_path, obj_path);
+
+            _add_artifact(&artifacts, src_full_path, obj_path, 1);
+            rebuilt[i] = 1;
             any_compiled = 1;
-            cmd_started = 1;
         }
+
+        int variants = emit_variants(force_recompile, cfg, &artifacts, jobs);
+        generate_plan_free(&gen);
+        if (variants < 0) {
+            r = -1;
+            goto _free;
+        }
+        if (variants) any_compiled = 1;
     }
     
 
@@ -256,58 +969,96 @@ int build_config_emit_cmd(int force_recompile, const compiler_conf *cfg, char *o
     
         
     
-        if (any_compiled) {
-            need_link = 1;
-            printf("%s[link]%s %s (objects updated)\n", 
-                   abs_fore.blue, abs_fore.normal, cfg->output);
-        } 
-    
-        else {
-            need_link = 0;
-            
-            char out_path[PATH_MAX];
-            if (is_library) {
-                snprintf(out_path, sizeof(out_path), "%s/%slib%s.%s", 
-                        cfg->out_dir, 
-                        cfg->output ? "" : "lib", 
-                        cfg->output,
-                        strcmp(cfg->build_type, "static") == 0 ? "a" : "so");
-            } else {
-                snprintf(out_path, sizeof(out_path), "%s/%s", cfg->out_dir, cfg->output);
-            }
-            
-            struct stat out_st;
-        
-            if (stat(out_path, &out_st) != 0) {
-                need_link = 1;
-                printf("%s[link]%s %s (binary missing)\n", 
-                       abs_fore.blue, abs_fore.normal, cfg->output);
-            } else {
-            
-                for (size_t i = 0; i < artifacts.obj_n; i++) {
-                    struct stat obj_st;
-                    if (stat(artifacts.obj_paths[i], &obj_st) == 0) {
-                        if (obj_st.st_mtime > out_st.st_mtime) {
-                            need_link = 1;
-                            printf("%s[link]%s %s (object newer than binary)\n", 
-                                   abs_fore.blue, abs_fore.normal, cfg->output);
-                            break;
-                        }
-                    }
-                }
-                
-                if (!need_link) {
-                    printf("%s[skip]%s %s (up to date)\n", 
-                           abs_fore.cyan, abs_fore.normal, cfg->output);
+        char out_path[PATH_MAX];
+        get_output_path(cfg, out_path, sizeof(out_path));
+        char dwp_path[PATH_MAX + 8];
+        snprintf(dwp_path, sizeof(dwp_path), "%s.dwp", out_path);
+
+        char stamp_path[PATH_MAX + 16];
+        snprintf(stamp_path, sizeof(stamp_path), "%s/link.stamp", cfg->obj_dir);
+
+        char version_script[PATH_MAX + 8];
+        int has_script = shared_write_version_script(cfg, version_script, sizeof(version_script));
+        if (has_script < 0) {
+            fprintf(stderr, "%s[error]%s failed to write version script\n", abs_fore.red, abs_fore.normal);
+            r = -1;
+            goto _free;
+        }
+
+        // reasons besides this run's compiles, which restat may still turn into no-ops
+        char other[PATH_MAX * 2] = "";
+        struct stat out_st, stamp_st;
+        if (stat(out_path, &out_st) != 0) {
+            snprintf(other, sizeof(other), "binary missing");
+        } else if (is_library && strcmp(cfg->build_type, "static") == 0 &&
+                   archive_needs_rewrite(cfg, &artifacts, out_path)) {
+            snprintf(other, sizeof(other), "archive members changed");
+        } else if (cfg->dwp && is_split_debug(cfg) && access(dwp_path, F_OK) != 0) {
+            snprintf(other, sizeof(other), "dwp package missing");
+        } else {
+            // an identical relink keeps the output's old mtime, the stamp says when it ran
+            time_t linked = out_st.st_mtime;
+            if (stat(stamp_path, &stamp_st) == 0 && stamp_st.st_mtime > linked) linked = stamp_st.st_mtime;
+
+            for (size_t i = 0; i < artifacts.obj_n && !*other; i++) {
+                struct stat obj_st;
+                if (artifacts.fresh[i]) continue;
+                if (stat(artifacts.obj_paths[i], &obj_st) == 0 && obj_st.st_mtime > linked) {
+                    if (cfg->explain)
+                        snprintf(other, sizeof(other), "object %s newer than binary", artifacts.obj_paths[i]);
+                    else
+                        snprintf(other, sizeof(other), "object newer than binary");
                 }
             }
+            // a static library relinks nothing, its users pick up the change
+            char lib[PATH_MAX];
+            if (!*other && !(is_library && strcmp(cfg->build_type, "static") == 0) &&
+                newer_dependency_lib(cfg, linked, lib, sizeof(lib))) {
+                snprintf(other, sizeof(other), "library %s changed", lib);
+            }
+            struct stat map_st;
+            if (!*other && has_script > 0 && stat(version_script, &map_st) == 0 && map_st.st_mtime > linked) {
+                snprintf(other, sizeof(other), "version script changed");
+            }
         }
-    
 
+        char why[PATH_MAX * 2] = "";
+        if (*other) {
+            snprintf(why, sizeof(why), "%s", other);
+        } else if (any_compiled && cfg->explain) {
+            size_t recompiled = 0;
+            for (size_t j = first_job; j < jobs->n; j++) {
+                if (jobs->jobs[j].kind == JOB_COMPILE) recompiled++;
+            }
+            snprintf(why, sizeof(why), "%zu objects recompiled", recompiled);
+        } else if (any_compiled) {
+            snprintf(why, sizeof(why), "objects updated");
+        }
+
+        char tagged[PATH_MAX + 160];
+        const char *link_label = job_label(cfg, cfg->output, tagged, sizeof(tagged));
+        need_link = *why != '\0';
         if (need_link) {
-        
-            if (cmd_started) {
-                pos += snprintf(out_buf + pos, out_sz - pos, "&& ");
+            printf("%s[link]%s %s (%s)\n", abs_fore.blue, abs_fore.normal, link_label, why);
+        } else {
+            printf("%s[skip]%s %s (up to date)\n", abs_fore.cyan, abs_fore.normal, link_label);
+        }
+
+        if (need_link) {
+            char *out_buf = malloc(ABS_CMD_MAX);
+            size_t out_sz = ABS_CMD_MAX, pos = 0;
+            char link_log[PATH_MAX + 16];
+            snprintf(link_log, sizeof(link_log), "%s/link.log", cfg->obj_dir);
+
+            // archives are updated in place; binaries and shared libraries link next to the output
+            char self[PATH_MAX];
+            int restat = cfg->restat && (!is_library || strcmp(cfg->build_type, "shared") == 0) &&
+                         abs_self(cfg, self, sizeof(self)) == 0;
+            char link_target[PATH_MAX + 8];
+            snprintf(link_target, sizeof(link_target), restat ? "%s.tmp" : "%s", out_path);
+            if (!out_buf) {
+                r = -1;
+                goto _free;
             }
             
             if (is_library) {
@@ -316,26 +1067,20 @@ int build_config_emit_cmd(int force_recompile, const compiler_conf *cfg, char *o
                     snprintf(lib_path, sizeof(lib_path), "%s/%slib%s.a", 
                             cfg->out_dir, cfg->output ? "" : "lib", cfg->output);
                     
-                    pos += snprintf(out_buf + pos, out_sz - pos, "ar rcs \"%s\" ", lib_path);
-                    
-                    for (size_t i = 0; i < artifacts.obj_n; i++) {
-                        pos += snprintf(out_buf + pos, out_sz - pos, "\"%s\" ", 
-                                       artifacts.obj_paths[i]);
-                    }
+                    pos = build_archive_cmd(cfg, &artifacts, lib_path, out_buf, out_sz, pos);
                 } else if (strcmp(cfg->build_type, "shared") == 0) {
                     char lib_path[PATH_MAX];
                     snprintf(lib_path, sizeof(lib_path), "%s/%slib%s.so", 
                             cfg->out_dir, cfg->output ? "" : "lib", cfg->output);
                     
-                    pos += snprintf(out_buf + pos, out_sz - pos, "%s -shared -o \"%s\" ", 
-                                   cfg->compiler, lib_path);
-                    
-                    for (size_t i = 0; i < artifacts.obj_n; i++) {
-                        pos += snprintf(out_buf + pos, out_sz - pos, "\"%s\" ", 
-                                       artifacts.obj_paths[i]);
-                    }
-                    
+                    pos += snprintf(out_buf + pos, out_sz - pos, "%s -shared ", cfg->compiler);
+                    pos = build_link_flags(cfg, out_buf, out_sz, pos);
+                    pos = build_shared_ldflags(cfg, has_script > 0 ? version_script : NULL, out_buf, out_sz, pos);
+                    pos += snprintf(out_buf + pos, out_sz - pos, "-o \"%s\" ", link_target);
+                    pos = build_object_list(cfg, &artifacts, NULL, out_buf, out_sz, pos);
                     pos = build_ldlibs(cfg, out_buf, out_sz, pos);
+                    pos = build_restat_cmd(restat ? self : NULL, link_target, lib_path, out_buf, out_sz, pos);
+                    pos = build_dwp_cmd(cfg, &artifacts, lib_path, out_buf, out_sz, pos);
                 }
             } else {
                 char bin_path[PATH_MAX];
@@ -343,28 +1088,77 @@ int build_config_emit_cmd(int force_recompile, const compiler_conf *cfg, char *o
                 
                 pos += snprintf(out_buf + pos, out_sz - pos, "%s ", cfg->compiler);
                 pos = build_common_flags(cfg, out_buf, out_sz, pos);
-                
-                for (size_t i = 0; i < artifacts.obj_n; i++) {
-                    pos += snprintf(out_buf + pos, out_sz - pos, "\"%s\" ", 
-                                   artifacts.obj_paths[i]);
-                }
-                
+                pos = build_link_flags(cfg, out_buf, out_sz, pos);
+                pos = build_object_list(cfg, &artifacts, NULL, out_buf, out_sz, pos);
                 pos = build_ldlibs(cfg, out_buf, out_sz, pos);
                 
-                pos += snprintf(out_buf + pos, out_sz - pos, "-o \"%s\"", bin_path);
+                pos += snprintf(out_buf + pos, out_sz - pos, "-o \"%s\" ", link_target);
+                pos = build_restat_cmd(restat ? self : NULL, link_target, bin_path, out_buf, out_sz, pos);
+                pos = build_dwp_cmd(cfg, &artifacts, bin_path, out_buf, out_sz, pos);
             }
-            
-            cmd_started = 1;
+            pos += snprintf(out_buf + pos, out_sz - pos, "&& touch \"%s\" ", stamp_path);
+
+            size_t compiles_end = jobs->n;
+            long link = jobs_add(jobs, JOB_LINK, link_label, out_buf, link_log, NULL);
+            for (size_t j = first_job; link >= 0 && j < compiles_end; j++) {
+                jobs_depend(jobs, link, j);
+            }
+            // only this run's compiles call for the link, which is moot if they changed nothing
+            if (link >= 0) {
+                jobs->jobs[link].cutoff = !*other;
+                if (restat) jobs_restat(jobs, link, out_path);
+            }
+            free(out_buf);
         }
     }
     
-    if (!cmd_started) {
+    if (jobs->n == first_job) {
         printf("%s[info]%s nothing to do\n", abs_fore.yellow, abs_fore.normal);
-        pos += snprintf(out_buf + pos, out_sz - pos, "true");
     }
-    
+
+_free:
+    if (minfo) {
+        for (size_t i = 0; i < cfg->sources_n; i++) module_info_free(&minfo[i]);
+    }
+    free(minfo);
+    free(order);
+    free(rebuilt);
+    free(job_of);
     _free_artifacts(&artifacts);
-    return 0;
+    return r;
+}
+
+// the planned jobs as a single `&&` chain
+int build_config_emit_cmd(int force_recompile, const compiler_conf *cfg, char *out_buf, size_t out_sz) {
+    job_list jobs;
+    jobs_init(&jobs);
+
+    int r = build_config_emit_jobs(force_recompile, cfg, &jobs);
+    if (r == 0) jobs_format(&jobs, out_buf, out_sz);
+
+    jobs_free(&jobs);
+    return r;
+}
+
+// removes the objects of the last build, and the directory once empty
+void cleanup_objects(const compiler_conf *cfg) {
+    if (!cfg->obj_dir) return;
+
+    DIR* dp;
+    struct dirent* ep;
+
+    dp = opendir(cfg->obj_dir);
+    if (dp != NULL){
+        while((ep = readdir(dp))){
+            // subdirectories hold outputs of other commands (bench results, ...)
+            if (ep->d_type == DT_DIR) continue;
+            char path[PATH_MAX];
+            snprintf(path, PATH_MAX, "%s/%s", cfg->obj_dir, ep->d_name);
+            remove(path);
+        }
+        closedir(dp);
+    }
+    rmdir(cfg->obj_dir);
 }
 
 void compiler_conf_free(compiler_conf *cfg) {
@@ -376,7 +1170,27 @@ void compiler_conf_free(compiler_conf *cfg) {
     if (cfg->include_dirs) _free_str_array(&cfg->include_dirs, &cfg->include_n);
     if (cfg->pkg_config_libs) _free_str_array(&cfg->pkg_config_libs, &cfg->pkg_config_libs_n);
     if (cfg->defines) _free_str_array(&cfg->defines, &cfg->defines_n);
+    if (cfg->src_flag_globs) {
+        size_t globs_n = cfg->src_flags_n;
+        _free_str_array(&cfg->src_flag_globs, &globs_n);
+    }
+    if (cfg->src_flag_values) _free_str_array(&cfg->src_flag_values, &cfg->src_flags_n);
+    if (cfg->variant_sources) _free_str_array(&cfg->variant_sources, &cfg->variant_sources_n);
+    if (cfg->variant_levels) _free_str_array(&cfg->variant_levels, &cfg->variant_levels_n);
+    if (cfg->variant_symbols) _free_str_array(&cfg->variant_symbols, &cfg->variant_symbols_n);
     if (cfg->lib_dirs) _free_str_array(&cfg->lib_dirs, &cfg->lib_dirs_n);
+    if (cfg->workers) _free_str_array(&cfg->workers, &cfg->workers_n);
+    if (cfg->prefix_maps) _free_str_array(&cfg->prefix_maps, &cfg->prefix_maps_n);
+    if (cfg->exports) _free_str_array(&cfg->exports, &cfg->exports_n);
+    if (cfg->export_headers) _free_str_array(&cfg->export_headers, &cfg->export_headers_n);
+    for (size_t i = 0; i < cfg->generators_n; i++) {
+        gen_rule *rule = &cfg->generators[i];
+        free(rule->name);
+        free(rule->command);
+        _free_str_array(&rule->inputs, &rule->inputs_n);
+        _free_str_array(&rule->outputs, &rule->outputs_n);
+    }
+    free(cfg->generators);
 
     if (cfg->output) free(cfg->output);
     if (cfg->src_dir) free(cfg->src_dir);
@@ -384,27 +1198,28 @@ void compiler_conf_free(compiler_conf *cfg) {
     if (cfg->pkg_config_path) free(cfg->pkg_config_path);
     if (cfg->build_type) free(cfg->build_type);
     if (cfg->build_phase) free(cfg->build_phase);
+    if (cfg->linker) free(cfg->linker);
+    if (cfg->debuginfo) free(cfg->debuginfo);
+    if (cfg->export_macro) free(cfg->export_macro);
     
-    if (cfg->obj_dir && cfg->cleanup){
-        DIR* dp;
-        struct dirent* ep;
-
-        dp = opendir(cfg->obj_dir);
-        if (dp != NULL){
-            while((ep = readdir(dp))){
-                char path[PATH_MAX];
-                snprintf(path, PATH_MAX, "%s/%s", cfg->obj_dir, ep->d_name);
-                remove(path);
-            }
-        }
-        closedir(dp);
-        rmdir(cfg->obj_dir);
-    }
+    if (cfg->cleanup) cleanup_objects(cfg);
     
     if (cfg->obj_dir) free(cfg->obj_dir);
 
     memset(cfg, 0, sizeof(compiler_conf));
 }
 
+// releases what config_for_mode made for one mode, leaving the base alone
+void config_mode_free(compiler_conf *cfg) {
+    if (!cfg) return;
+
+    if (cfg->cflags) _free_str_array(&cfg->cflags, &cfg->cflags_n);
+    if (cfg->cleanup) cleanup_objects(cfg);
+    free(cfg->obj_dir);
+    free(cfg->out_dir);
+
+    memset(cfg, 0, sizeof(compiler_conf));
+}
+
 #endif
 #define ABS_COMPILATION
\ No newline at end of file
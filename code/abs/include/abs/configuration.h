@@ -1,5 +1,9 @@
 #include "abs/colors.h"
 #include "ini.h"
+#include "arena.h"
+#include "probe.h"
+#include "stats.h"
+#include <stdarg.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <linux/limits.h>
@@ -11,6 +15,25 @@
 
 #ifndef ABS_CONFIGURATION
 
+// [compiler] shared_opt features, `true` for all of them
+#define SHARED_OPT_VISIBILITY  (1u << 0)   // -fvisibility=hidden
+#define SHARED_OPT_SYMBOLIC    (1u << 1)   // -Bsymbolic-functions, -fno-semantic-interposition
+#define SHARED_OPT_GNU_HASH    (1u << 2)   // --hash-style=gnu
+#define SHARED_OPT_AS_NEEDED   (1u << 3)   // --as-needed
+#define SHARED_OPT_NOW         (1u << 4)   // -z now
+#define SHARED_OPT_RELRO       (1u << 5)   // -z relro
+#define SHARED_OPT_ALL         0x3fu
+
+// [generate.NAME]: `command` turns `inputs` into `outputs`, paths from the config directory
+typedef struct {
+    char  *name;
+    char  *command;
+    char **inputs;
+    size_t inputs_n;
+    char **outputs;
+    size_t outputs_n;
+} gen_rule;
+
 typedef struct {
 	const char *compiler;
 
@@ -26,6 +49,9 @@ typedef struct {
     size_t sources_n;
     char  *output;
 
+    gen_rule *generators;
+    size_t    generators_n;
+
     char *src_dir;
     char *out_dir;
     char **include_dirs;
@@ -39,13 +65,53 @@ typedef struct {
     char **defines;
     size_t defines_n;
 
+    char **src_flag_globs;   // [flags.per_source] keys
+    char **src_flag_values;
+    size_t src_flags_n;
+
+    char **variant_sources;  // [variants], built once per level
+    size_t variant_sources_n;
+    char **variant_levels;
+    size_t variant_levels_n;
+    char **variant_symbols;
+    size_t variant_symbols_n;
+
     char *build_type;
     char *build_phase;
     char *obj_dir;
 
+    bool  thin_archive;      // `ar T`: static libraries reference objects in place
+
+    char *linker;            // -fuse-ld value, NULL for the driver default
+    char *debuginfo;         // NULL, "split" or "compressed"
+    bool  dwp;
+
+    char **workers;          // [executor] endpoints, `unix:PATH` or `tcp:[HOST:]PORT`
+    size_t workers_n;
+    int    jobs;             // parallel jobs, 1 unless workers are set
+
     char *active_mode;
+    const char *mode_tag;    // --modes: the mode, shown after job labels
     bool  hardening;
     bool  cleanup;
+
+    bool  restat;            // keep identical outputs and their timestamps
+    unsigned shared_opt;     // SHARED_OPT_* bits, shared builds only
+    char **exports;          // [shared] exports, version script globals
+    size_t exports_n;
+    char **export_headers;   // [shared] headers, scanned for export_macro
+    size_t export_headers_n;
+    char  *export_macro;
+
+    bool  reproducible;      // path and time independent outputs
+    char **prefix_maps;      // directories written as `.` into outputs
+    size_t prefix_maps_n;
+    const char *self_path;   // abs executable run inside jobs, NULL for this process, "" for none
+
+    bool  explain;           // --explain: give the reason of every job
+    bool  dry_run;           // -n: plan only, leave no state behind
+    bool  progress;          // --progress lines or status: objects are reported when done, not planned
+    bool  profile;           // --profile-compile: -ftime-trace (clang) or -ftime-report (gcc)
 } compiler_conf;
 
 static int has_glob_chars(const char *str) {
@@ -55,10 +121,8 @@ static int has_glob_chars(const char *str) {
 static int _cfg_append_str(char ***arr, size_t *n, const char *str) {
     if (!str) return 0;
 
-    char **tmp = realloc(*arr, sizeof(char*) * (*n + 1));
-    if (!tmp) return -1;
+    if (abs_grow(arr, *n, sizeof(char*)) != 0) return -1;
 
-    *arr = tmp;
     (*arr)[*n] = strdup(str);
     if (!(*arr)[*n]) return -1;
 
@@ -89,6 +153,25 @@ static int _cfg_append_flags(char ***arr, size_t *n, const char *flags) {
     return 0;
 }
 
+// like _cfg_append_flags, but drops flags the compiler rejects
+static int _cfg_append_optional(char ***arr, size_t *n, const char *compiler, const char *flags,
+                                probe_compiler *pc) {
+    if (!flags || !*flags) return 0;
+
+    char *buf = strdup(flags);
+    if (!buf) return -1;
+
+    char *saveptr = NULL;
+    for (char *token = strtok_r(buf, " \t\n", &saveptr); token; token = strtok_r(NULL, " \t\n", &saveptr)) {
+        if (*token && probe_flag(compiler, token, pc)) {
+            _cfg_append_str(arr, n, token);
+        }
+    }
+
+    free(buf);
+    return 0;
+}
+
 static char **_str_split(const char *str, char delim, size_t *out_n) {
     if (!str || !out_n) return NULL;
 
@@ -136,7 +219,7 @@ char *get_dir_from_path(const char *filepath) {
     return result;
 }
 
-static int expand_sources(const char *src_dir, const char *sources_str, compiler_conf *cfg) {
+static int expand_sources(const char *src_dir, const char *sources_str, char ***out_arr, size_t *out_n) {
     if (!sources_str) return -1;
 
     char *buf = strdup(sources_str);
@@ -179,7 +262,7 @@ static int expand_sources(const char *src_dir, const char *sources_str, compiler
                         }
 
                         if (relative_path) {
-                            _cfg_append_str(&cfg->sources, &cfg->sources_n, relative_path);
+                            _cfg_append_str(out_arr, out_n, relative_path);
                             free(relative_path);
                         }
                     }
@@ -188,7 +271,7 @@ static int expand_sources(const char *src_dir, const char *sources_str, compiler
                     fprintf(stderr, "%s[warn]%s no files matched pattern: %s\n", abs_fore.yellow, abs_fore.normal, token);
                 }
             } else {
-                _cfg_append_str(&cfg->sources, &cfg->sources_n, token);
+                _cfg_append_str(out_arr, out_n, token);
             }
         }
         token = strtok_r(NULL, " \t\n", &saveptr);
@@ -352,9 +435,27 @@ static int expand_dir_paths(const char *base_dir, const char *dirs_str,
     return 0;
 }
 
-int build_modules(const char *prog, const char *config_dir, ini_config *ini, int force_recompile){
-    if (ini_check(ini, "modules") != 0) return 1;
-
+// command line switches shared by the root build and its module builds
+typedef struct {
+    int  force_recompile;
+    bool keep_going;
+    int  jobs;          // -j, 0 for the config's [executor] jobs
+    bool stats;         // --stats, passed on to modules
+    bool explain;       // --explain
+    bool dry_run;       // -n
+    jobs_output progress;   // --progress, resolved from auto
+    bool profile;       // --profile-compile, root configuration only
+    const char *modes;  // --modes, comma-separated modes built together
+} build_opts;
+
+/*
+ * Builds every [modules] entry with a child abs. Returns the number of
+ * failed modules; without keep-going it stops at the first failure.
+ */
+int build_modules(const char *prog, const char *config_dir, ini_config *ini, const build_opts *opts){
+    if (ini_check(ini, "modules") != 0) return 0;
+
+    int failed = 0;
     ini_iterator it = ini_iterator_init(ini);
     for (
         ini_iter i = ini_iterate(&it);
@@ -372,44 +473,237 @@ int build_modules(const char *prog, const char *config_dir, ini_config *ini, int
         free(inconf_path);
 
         const char *inconf_confpath = struntilnot(strchr(i.value, ',') + 1, ' ');
-        if (!force_recompile){
-            snprintf(command, PATH_MAX + 512, "cd %s && MAIN_DIR=%s %s %s", cdpath_buf, config_dir, prog, inconf_confpath);
-        } else {
-            snprintf(command, PATH_MAX + 512, "cd %s && MAIN_DIR=%s %s -r %s", cdpath_buf, config_dir, prog, inconf_confpath);
-        }
+        char jobs_arg[32] = "";
+        if (opts->jobs > 0) snprintf(jobs_arg, sizeof(jobs_arg), " -j %d", opts->jobs);
+        snprintf(command, PATH_MAX + 512, "cd %s && MAIN_DIR=%s %s%s%s%s%s%s%s --progress %s %s", cdpath_buf, config_dir, prog,
+                 jobs_arg,
+                 opts->force_recompile ? " -r" : "",
+                 opts->keep_going ? " -k" : "",
+                 opts->stats ? " --stats" : "",
+                 opts->explain ? " --explain" : "",
+                 opts->dry_run ? " -n" : "",
+                 jobs_output_names[opts->progress],
+                 inconf_confpath);
+        double started = stats_now_ms();
         int r = system(command);
+        stats_module_done(i.key, stats_now_ms() - started, r == 0);
 
         if (r == 0){
             printf("%s[modules][%s]%s: build %sSUCCESS%s\n", abs_fore.yellow, i.key, abs_fore.normal, abs_fore.green, abs_fore.normal);
         } else {
             printf("%s[modules][%s]%s: build %sFAIL%s\n", abs_fore.yellow, i.key, abs_fore.normal, abs_fore.red, abs_fore.normal);
-            exit(-1);
+            failed++;
+            if (!opts->keep_going) break;
         }
     }
 
+    return failed;
+}
+
+/*
+ * Sets the directory the configuration lives in. Reproducible builds map it,
+ * the working directory and $MAIN_DIR of a module build to `.` in debug
+ * info and __FILE__, the most specific one last so it wins.
+ */
+void config_set_root(compiler_conf *cfg, const char *root){
+    if (!cfg->reproducible) return;
+
+    char cwd[PATH_MAX];
+    const char *dirs[] = { getenv("MAIN_DIR"), root, getcwd(cwd, sizeof(cwd)) };
+    for (size_t i = 0; i < sizeof(dirs) / sizeof(dirs[0]); i++){
+        if (!dirs[i] || !*dirs[i]) continue;
+        int seen = 0;
+        for (size_t k = 0; k < cfg->prefix_maps_n && !seen; k++)
+            seen = strcmp(cfg->prefix_maps[k], dirs[i]) == 0;
+        if (!seen) _cfg_append_str(&cfg->prefix_maps, &cfg->prefix_maps_n, dirs[i]);
+    }
+}
+
+// generated outputs with these extensions are compiled; headers and the rest are dependencies only
+static const char *compiled_extensions[] = {
+    ".c", ".cc", ".cpp", ".cxx", ".C", ".CPP", ".cppm", ".ixx", NULL
+};
+
+static int is_compiled_source(const char *path){
+    const char *dot = strrchr(path, '.');
+    for (int i = 0; dot && compiled_extensions[i]; i++){
+        if (strcmp(dot, compiled_extensions[i]) == 0) return 1;
+    }
     return 0;
 }
 
+// last configuration error, kept per thread for library callers
+static __thread char abs_config_error[512];
+
+__attribute__((format(printf, 1, 2)))
+static int _cfg_error(const char *fmt, ...){
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(abs_config_error, sizeof(abs_config_error), fmt, ap);
+    va_end(ap);
+
+    fprintf(stderr, "%s[error]%s %s\n", abs_fore.red, abs_fore.normal, abs_config_error);
+    return -1;
+}
+
 char *nstrdup(const char *str){
     if (!str) return NULL;
     return strdup(str);
 }
 
-int config_ini_parse(ini_config *ini, compiler_conf *cfg){
-    cfg->active_mode = ini_get_at(ini, "modes", "active");
-    if (!cfg->active_mode) cfg->active_mode = "debug";
+// expands `$NAME` and `${NAME}` from the environment, e.g. `$MAIN_DIR/bin`
+char *expand_env(const char *str){
+    if (!str) return NULL;
 
-    cfg->compiler = ini_get_at(ini, "compiler", "cc");
-    if (!cfg->compiler) cfg->compiler = "gcc";
+    char out[PATH_MAX];
+    size_t pos = 0;
+    for (const char *p = str; *p && pos + 1 < sizeof(out); ){
+        if (*p != '$'){
+            out[pos++] = *p++;
+            continue;
+        }
+
+        int braced = p[1] == '{';
+        const char *name = p + 1 + braced;
+        size_t len = 0;
+        while (name[len] == '_' || (name[len] >= 'a' && name[len] <= 'z') ||
+               (name[len] >= 'A' && name[len] <= 'Z') || (name[len] >= '0' && name[len] <= '9'))
+            len++;
+
+        if (len == 0 || (braced && name[len] != '}')){
+            out[pos++] = *p++;
+            continue;
+        }
+
+        char var[256];
+        snprintf(var, sizeof(var), "%.*s", (int)len, name);
+        const char *value = getenv(var);
+        if (value) pos += snprintf(out + pos, sizeof(out) - pos, "%s", value);
+        if (pos >= sizeof(out)) pos = sizeof(out) - 1;
+
+        p = name + len + braced;
+    }
+    out[pos] = '\0';
+
+    return strdup(out);
+}
+
+// nstrdup with environment expansion, for directory settings
+static char *_cfg_dir(ini_config *ini, const char *key){
+    return expand_env(ini_get_at(ini, "dirs", key));
+}
+
+/*
+ * Reads every [generate.NAME] section. Generated sources under [dirs] src
+ * join the source list, whether or not they exist yet.
+ */
+static int _cfg_generators(ini_config *ini, compiler_conf *cfg){
+    ini_iterator it = ini_iterator_init(ini);
+    for (ini_iter i = ini_iterate(&it); i.sec_name; i = ini_iterate(&it)){
+        if (strncmp(i.sec_name, "generate.", 9) != 0 || !i.sec_name[9]) continue;
+        const char *name = i.sec_name + 9;
+        int seen = 0;
+        for (size_t g = 0; g < cfg->generators_n && !seen; g++)
+            seen = strcmp(cfg->generators[g].name, name) == 0;
+        if (seen) continue;
+
+        if (abs_grow(&cfg->generators, cfg->generators_n, sizeof(gen_rule)) != 0)
+            return _cfg_error("out of memory");
+        gen_rule *rule = &cfg->generators[cfg->generators_n++];
+        memset(rule, 0, sizeof(*rule));
+        rule->name = strdup(name);
+        rule->command = nstrdup(ini_get_at(ini, i.sec_name, "command"));
+        if (!rule->command) return _cfg_error("[%s] has no command", i.sec_name);
+
+        const char *inputs = ini_get_at(ini, i.sec_name, "inputs");
+        if (inputs) expand_sources(NULL, inputs, &rule->inputs, &rule->inputs_n);
+        _cfg_append_flags(&rule->outputs, &rule->outputs_n, ini_get_at(ini, i.sec_name, "outputs"));
+        if (rule->outputs_n == 0) return _cfg_error("[%s] has no outputs", i.sec_name);
+
+        size_t src_len = strcmp(cfg->src_dir, ".") == 0 ? 0 : strlen(cfg->src_dir);
+        for (size_t o = 0; o < rule->outputs_n; o++){
+            const char *out = rule->outputs[o];
+            if (has_glob_chars(out)) return _cfg_error("[%s] outputs are files, not patterns: %s", i.sec_name, out);
+            if (!is_compiled_source(out)) continue;
+
+            if (src_len && (strncmp(out, cfg->src_dir, src_len) != 0 || out[src_len] != '/'))
+                return _cfg_error("[%s] generates %s outside [dirs] src", i.sec_name, out);
+            const char *src = out + (src_len ? src_len + 1 : 0);
+            while (src[0] == '.' && src[1] == '/') src += 2;
+
+            int listed = 0;
+            for (size_t s = 0; s < cfg->sources_n && !listed; s++)
+                listed = strcmp(cfg->sources[s], src) == 0;
+            if (!listed) _cfg_append_str(&cfg->sources, &cfg->sources_n, src);
+        }
+    }
+    return 0;
+}
+
+// [dirs] objects, `.objs` by default
+char *config_obj_dir(ini_config *ini){
+    char *dir = _cfg_dir(ini, "objects");
+    return dir ? dir : strdup(".objs");
+}
+
+// `auto` picks the fastest linker the compiler driver can use
+static char *_cfg_resolve_linker(const char *compiler, const char *linker, probe_compiler *pc) {
+    if (!linker || strcmp(linker, "default") == 0) return NULL;
+    if (strcmp(linker, "auto") != 0) return strdup(linker);
+
+    static const char *candidates[] = {"mold", "lld", "gold", NULL};
+
+    for (int i = 0; candidates[i]; i++) {
+        char flag[64];
+        snprintf(flag, sizeof(flag), "-fuse-ld=%s", candidates[i]);
+        if (probe_flag(compiler, flag, pc)) return strdup(candidates[i]);
+    }
+    return NULL;
+}
+
+/*
+ * The flags of `cfg->active_mode`: common, [mode.NAME] flags, hardening
+ * when that mode asks for security, then the probed optional ones. Any
+ * [mode.NAME] section defines a mode; debug and release may be absent.
+ */
+static int _cfg_mode_flags(ini_config *ini, compiler_conf *cfg, probe_compiler *pc){
+    char mode_name[128];
+    snprintf(mode_name, sizeof(mode_name), "mode.%s", cfg->active_mode);
+    if (ini_check(ini, mode_name) != 0 && strcmp(cfg->active_mode, "debug") != 0 &&
+        strcmp(cfg->active_mode, "release") != 0) {
+        return _cfg_error("unknown mode: %s (no [%s] section)", cfg->active_mode, mode_name);
+    }
 
     _cfg_append_flags(&cfg->cflags, &cfg->cflags_n,
                       ini_get_at(ini, "flags", "common"));
+    _cfg_append_flags(&cfg->cflags, &cfg->cflags_n,
+                      ini_get_at(ini, mode_name, "flags"));
 
-    const char *mode_name = (strcmp(cfg->active_mode, "debug") == 0)
-                            ? "mode.debug" : "mode.release";
-    if (mode_name)
+    const char *sec = ini_get_at(ini, mode_name, "security");
+    cfg->hardening = sec && strcmp(sec, "true") == 0;
+    if (cfg->hardening) {
         _cfg_append_flags(&cfg->cflags, &cfg->cflags_n,
-                        ini_get_at(ini, mode_name, "flags"));
+                        ini_get_at(ini, "flags", "hardening"));
+    }
+
+    _cfg_append_optional(&cfg->cflags, &cfg->cflags_n, cfg->compiler,
+                         ini_get_at(ini, "flags", "optional"), pc);
+    _cfg_append_optional(&cfg->cflags, &cfg->cflags_n, cfg->compiler,
+                         ini_get_at(ini, mode_name, "optional"), pc);
+    return 0;
+}
+
+static int _cfg_parse(ini_config *ini, compiler_conf *cfg, probe_compiler *pc){
+    cfg->active_mode = ini_get_at(ini, "modes", "active");
+    if (!cfg->active_mode) cfg->active_mode = "debug";
+    // set by `abs bench`; modules inherit it through the environment
+    const char *mode_env = getenv("ABS_MODE");
+    if (mode_env && *mode_env) cfg->active_mode = (char*)mode_env;
+
+    cfg->compiler = ini_get_at(ini, "compiler", "cc");
+    if (!cfg->compiler) cfg->compiler = "gcc";
+
+    if (_cfg_mode_flags(ini, cfg, pc) != 0) return -1;
 
     cfg->build_type = nstrdup(ini_get_at(ini, "compiler", "build"));
     if (!cfg->build_type) cfg->build_type = strdup("binary");
@@ -417,52 +711,99 @@ int config_ini_parse(ini_config *ini, compiler_conf *cfg){
     cfg->build_phase = nstrdup(ini_get_at(ini, "compiler", "phase"));
     if (!cfg->build_phase) cfg->build_phase = strdup("all");
 
-    const char *sec = ini_get_at(ini,
-        cfg->active_mode[0] == 'd' ? "mode.debug" : "mode.release",
-        "security");
-    cfg->hardening = sec && strcmp(sec, "true") == 0;
-
     const char *cleanup = ini_get_at(ini, "compiler", "cleanup");
     cfg->cleanup = (cleanup == NULL) || strcmp(cleanup, "true") == 0;
 
-    if (cfg->hardening) {
-        _cfg_append_flags(&cfg->cflags, &cfg->cflags_n,
-                        ini_get_at(ini, "flags", "hardening"));
+    const char *restat = ini_get_at(ini, "compiler", "restat");
+    cfg->restat = (restat == NULL) || strcmp(restat, "true") == 0;
+
+    const char *shared_opt = ini_get_at(ini, "compiler", "shared_opt");
+    if (shared_opt && strcmp(shared_opt, "true") == 0) {
+        cfg->shared_opt = SHARED_OPT_ALL;
+    } else if (shared_opt && strcmp(shared_opt, "false") != 0) {
+        static const struct { const char *name; unsigned bit; } opts[] = {
+            { "visibility", SHARED_OPT_VISIBILITY }, { "symbolic", SHARED_OPT_SYMBOLIC },
+            { "gnu-hash", SHARED_OPT_GNU_HASH },     { "as-needed", SHARED_OPT_AS_NEEDED },
+            { "now", SHARED_OPT_NOW },               { "relro", SHARED_OPT_RELRO },
+        };
+        size_t words_n = 0;
+        char **words = _str_split(shared_opt, ' ', &words_n);
+        for (size_t w = 0; w < words_n; w++) {
+            size_t k = 0;
+            while (k < sizeof(opts) / sizeof(opts[0]) && strcmp(opts[k].name, words[w]) != 0) k++;
+            if (k == sizeof(opts) / sizeof(opts[0])) {
+                _cfg_error("unknown shared_opt: %s (visibility, symbolic, gnu-hash, as-needed, now, relro)", words[w]);
+                for (size_t i = 0; i < words_n; i++) free(words[i]);
+                free(words);
+                return -1;
+            }
+            cfg->shared_opt |= opts[k].bit;
+        }
+        for (size_t i = 0; i < words_n; i++) free(words[i]);
+        free(words);
+    }
+    _cfg_append_flags(&cfg->exports, &cfg->exports_n, ini_get_at(ini, "shared", "exports"));
+    const char *export_headers = ini_get_at(ini, "shared", "headers");
+    if (export_headers) {
+        expand_sources(NULL, export_headers, &cfg->export_headers, &cfg->export_headers_n);
+    }
+    cfg->export_macro = nstrdup(ini_get_at(ini, "shared", "macro"));
+    if (!cfg->export_macro) cfg->export_macro = strdup("ABS_EXPORT");
+
+    const char *reproducible = ini_get_at(ini, "compiler", "reproducible");
+    cfg->reproducible = reproducible && strcmp(reproducible, "true") == 0;
+
+    const char *thin = ini_get_at(ini, "compiler", "thin_archive");
+    cfg->thin_archive = thin && strcmp(thin, "true") == 0;
+    if (cfg->thin_archive && cfg->cleanup) {
+        // a thin archive is only an index of the objects, they must stay
+        fprintf(stderr, "%s[warn]%s thin_archive = true keeps the objects directory (cleanup disabled)\n",
+                abs_fore.yellow, abs_fore.normal);
+        cfg->cleanup = false;
     }
 
-    cfg->obj_dir = nstrdup(ini_get_at(ini, "dirs", "objects"));
-    if (!cfg->obj_dir) {
-        cfg->obj_dir = strdup(".objs");
+    cfg->linker = _cfg_resolve_linker(cfg->compiler, ini_get_at(ini, "compiler", "linker"), pc);
+
+    cfg->debuginfo = nstrdup(ini_get_at(ini, "compiler", "debuginfo"));
+    if (cfg->debuginfo && strcmp(cfg->debuginfo, "split") != 0 &&
+        strcmp(cfg->debuginfo, "compressed") != 0) {
+        return _cfg_error("unknown debuginfo mode: %s (split or compressed)", cfg->debuginfo);
     }
 
+    const char *dwp = ini_get_at(ini, "compiler", "dwp");
+    cfg->dwp = dwp && strcmp(dwp, "true") == 0;
+
+    if (cfg->debuginfo && strcmp(cfg->debuginfo, "split") == 0 && cfg->cleanup && !cfg->dwp) {
+        fprintf(stderr, "%s[warn]%s debuginfo = split with cleanup removes the .dwo files; "
+                "set dwp = true or cleanup = false to keep debug info\n",
+                abs_fore.yellow, abs_fore.normal);
+    }
+
+    cfg->obj_dir = config_obj_dir(ini);
+
+    double glob_started = stats_now_ms();
     const char *lib_dirs_ini = ini_get_at(ini, "dirs", "libs");
     const char *libs_ini = ini_get_at(ini, "dependencies", "libs");
 
     if (libs_ini) {
         if (expand_libs(libs_ini, cfg) != 0) {
-            fprintf(stderr, "%s[error]%s failed to process libs\n",
-                    abs_fore.red, abs_fore.normal);
-            exit(-1);
+            return _cfg_error("failed to process libs");
         }
     }
 
     if (lib_dirs_ini) {
         if (expand_dir_paths(".", lib_dirs_ini,
                             &cfg->lib_dirs, &cfg->lib_dirs_n) != 0) {
-            fprintf(stderr, "%s[error]%s failed to process lib dirs\n",
-                    abs_fore.red, abs_fore.normal);
-            exit(-1);
+            return _cfg_error("failed to process lib dirs");
         }
     }
 
     cfg->output = nstrdup(ini_get_at(ini, "files", "output"));
     if (!cfg->output){
-        fprintf(stderr, "%s[error]%s no output file set\n",
-                    abs_fore.red, abs_fore.normal);
-        exit(-1);
+        return _cfg_error("no output file set");
     }
 
-    cfg->src_dir = nstrdup(ini_get_at(ini, "dirs", "src"));
+    cfg->src_dir = _cfg_dir(ini, "src");
     if (!cfg->src_dir){
         cfg->src_dir = strdup(".");
     }
@@ -471,32 +812,48 @@ int config_ini_parse(ini_config *ini, compiler_conf *cfg){
     if (include_dirs_ini) {
         if (expand_dir_paths(".", include_dirs_ini,
                             &cfg->include_dirs, &cfg->include_n) != 0) {
-            fprintf(stderr, "%s[error]%s failed to process include dirs\n",
-                    abs_fore.red, abs_fore.normal);
-            exit(-1);
+            return _cfg_error("failed to process include dirs");
         }
     }
 
-    cfg->out_dir = nstrdup(ini_get_at(ini, "dirs", "output"));
+    cfg->out_dir = _cfg_dir(ini, "output");
     if (!cfg->out_dir){
         cfg->out_dir = strdup(".");
     }
 
     const char *src_list = ini_get_at(ini, "files", "sources");
     if (src_list) {
-        if (expand_sources(cfg->src_dir, src_list, cfg) != 0) {
-            fprintf(stderr, "%s[error]%s failed to process sources\n", abs_fore.red, abs_fore.normal);
-            exit(-1);
-        }
-        if (cfg->sources_n == 0) {
-             fprintf(stderr, "%s[error]%s no sources resolved\n", abs_fore.red, abs_fore.normal);
-             exit(-1);
+        if (expand_sources(cfg->src_dir, src_list, &cfg->sources, &cfg->sources_n) != 0) {
+            return _cfg_error("failed to process sources");
         }
     } else {
-        fprintf(stderr, "%s[error]%s no sources provided\n", abs_fore.red, abs_fore.normal);
-        exit(-1);
+        return _cfg_error("no sources provided");
+    }
+    if (_cfg_generators(ini, cfg) != 0) return -1;
+    if (cfg->sources_n == 0) {
+         return _cfg_error("no sources resolved");
     }
 
+    const char *variant_list = ini_get_at(ini, "variants", "sources");
+    if (variant_list) {
+        expand_sources(cfg->src_dir, variant_list, &cfg->variant_sources, &cfg->variant_sources_n);
+        _cfg_append_flags(&cfg->variant_levels, &cfg->variant_levels_n,
+                          ini_get_at(ini, "variants", "levels"));
+        _cfg_append_flags(&cfg->variant_symbols, &cfg->variant_symbols_n,
+                          ini_get_at(ini, "variants", "symbols"));
+
+        if (cfg->variant_levels_n == 0 || cfg->variant_symbols_n == 0) {
+            return _cfg_error("[variants] needs both levels and symbols");
+        }
+    }
+
+    abs_stats.glob_ms += stats_now_ms() - glob_started;
+
+    _cfg_append_flags(&cfg->workers, &cfg->workers_n, ini_get_at(ini, "executor", "workers"));
+    const char *jobs = ini_get_at(ini, "executor", "jobs");
+    cfg->jobs = jobs ? atoi(jobs) : (int)(cfg->workers_n * 2);
+    if (cfg->jobs < 1) cfg->jobs = 1;
+
     cfg->pkg_config_path = nstrdup(ini_get_at(ini, "dependencies", "pkg_config_path"));
     const char *pkg_list = ini_get_at(ini, "dependencies", "pkgs");
     if (pkg_list) {
@@ -509,11 +866,51 @@ int config_ini_parse(ini_config *ini, compiler_conf *cfg){
             char def[256];
             snprintf(def, sizeof(def), "-D%s=%s", d.key, d.value);
             _cfg_append_str(&cfg->defines, &cfg->defines_n, def);
+        } else if (strcmp(d.sec_name, "flags.per_source") == 0) {
+            size_t globs_n = cfg->src_flags_n;
+            _cfg_append_str(&cfg->src_flag_globs, &globs_n, d.key);
+            _cfg_append_str(&cfg->src_flag_values, &cfg->src_flags_n, d.value);
         }
     }
 
     return 0;
 }
 
+// the compiler is resolved and its probe cache read once per parse
+int config_ini_parse(ini_config *ini, compiler_conf *cfg){
+    probe_compiler pc = {0};
+    int r = _cfg_parse(ini, cfg, &pc);
+    probe_compiler_free(&pc);
+    return r;
+}
+
+/*
+ * One configuration of `abs --modes`: `base` parsed once, with the flags
+ * of `mode` and its own objects and output directories under the base
+ * ones. Everything else is shared with `base`; release the result with
+ * config_mode_free, never compiler_conf_free.
+ */
+int config_for_mode(ini_config *ini, const compiler_conf *base, const char *mode, compiler_conf *out){
+    *out = *base;
+    out->active_mode = (char*)mode;
+    out->mode_tag = mode;
+    out->cflags = NULL;
+    out->cflags_n = 0;
+    out->obj_dir = out->out_dir = NULL;
+    probe_compiler pc = {0};
+    int flags_r = _cfg_mode_flags(ini, out, &pc);
+    probe_compiler_free(&pc);
+    if (flags_r != 0) return -1;
+
+    size_t obj_len = strlen(base->obj_dir) + strlen(mode) + 2;
+    size_t out_len = strlen(base->out_dir) + strlen(mode) + 2;
+    out->obj_dir = malloc(obj_len);
+    out->out_dir = malloc(out_len);
+    if (!out->obj_dir || !out->out_dir) return _cfg_error("out of memory");
+    snprintf(out->obj_dir, obj_len, "%s/%s", base->obj_dir, mode);
+    snprintf(out->out_dir, out_len, "%s/%s", base->out_dir, mode);
+    return 0;
+}
+
 #endif
 #define ABS_CONFIGURATION
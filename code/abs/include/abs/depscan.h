@@ -0,0 +1,252 @@
+#include "configuration.h"
+#include "arena.h"
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifndef ABS_DEPSCAN
+
+/*
+ * In-process `#include` scanner. Headers are scanned once and remembered
+ * by path; a changed mtime/size only triggers a rescan of the include list
+ * when the content hash actually differs. Both the cache and the headers
+ * seen from one source are hashed by path, so a no-op scan stays linear
+ * in the size of the tree.
+ */
+
+typedef struct {
+    const char *path;    // interned in the cache's arena
+    dev_t    dev;
+    ino_t    ino;
+    off_t    size;
+    time_t   mtime;
+    uint64_t hash;
+
+    char   **includes;   // raw include names, as written in the file
+    char    *angled;     // angled[i] != 0 for <...> includes
+    size_t   includes_n;
+} depscan_entry;
+
+typedef struct {
+    depscan_entry *entries;
+    size_t         n;
+    abs_arena      arena;
+    abs_strmap     index;    // path to its entry
+} depscan_cache;
+
+// per thread, so library contexts on different threads never share it
+static __thread depscan_cache abs_depscan_cache = {0};
+
+static uint64_t depscan_hash(const char *data, size_t len){
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < len; i++){
+        h ^= (unsigned char)data[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+static void _depscan_clear_includes(depscan_entry *e){
+    for (size_t i = 0; i < e->includes_n; i++) free(e->includes[i]);
+    free(e->includes);
+    free(e->angled);
+    e->includes = NULL;
+    e->angled = NULL;
+    e->includes_n = 0;
+}
+
+static void _depscan_add_include(depscan_entry *e, const char *name, size_t len, char angled){
+    if (abs_grow(&e->includes, e->includes_n, sizeof(char*)) != 0 ||
+        abs_grow(&e->angled, e->includes_n, 1) != 0) return;
+
+    e->includes[e->includes_n] = strndup(name, len);
+    e->angled[e->includes_n] = angled;
+    e->includes_n++;
+}
+
+// finds `#include "x"` / `#include <x>` directives; '#' is located with memchr
+static void _depscan_parse(depscan_entry *e, const char *data, size_t len){
+    const char *end = data + len;
+    const char *p = data;
+
+    while (p < end && (p = memchr(p, '#', end - p)) != NULL){
+        const char *hash_pos = p++;
+
+        // only whitespace may precede '#' on its line
+        const char *b = hash_pos;
+        while (b > data && (b[-1] == ' ' || b[-1] == '\t')) b--;
+        if (b != data && b[-1] != '\n') continue;
+
+        while (p < end && (*p == ' ' || *p == '\t')) p++;
+        if (end - p < 7 || memcmp(p, "include", 7) != 0) continue;
+        p += 7;
+        while (p < end && (*p == ' ' || *p == '\t')) p++;
+        if (p >= end || (*p != '"' && *p != '<')) continue;
+
+        char close = *p == '"' ? '"' : '>';
+        const char *name = ++p;
+        const char *nl = memchr(p, '\n', end - p);
+        const char *stop = memchr(p, close, (nl ? nl : end) - p);
+        if (!stop) continue;
+
+        _depscan_add_include(e, name, stop - name, close == '>');
+        p = stop + 1;
+    }
+}
+
+static depscan_entry *depscan_lookup(depscan_cache *cache, const char *path){
+    struct stat st;
+    if (stat(path, &st) != 0 || !S_ISREG(st.st_mode)) return NULL;
+
+    depscan_entry *e = NULL;
+    size_t idx;
+    if (strmap_get(&cache->index, path, &idx)) e = &cache->entries[idx];
+
+    if (e && e->dev == st.st_dev && e->ino == st.st_ino &&
+        e->size == st.st_size && e->mtime == st.st_mtime){
+        return e;
+    }
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+
+    char *data = NULL;
+    if (st.st_size > 0){
+        data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED){
+            close(fd);
+            return NULL;
+        }
+    }
+    close(fd);
+
+    uint64_t h = data ? depscan_hash(data, st.st_size) : 0;
+
+    if (!e){
+        cache->index.arena = &cache->arena;
+        const char *key = NULL;
+        if (abs_grow(&cache->entries, cache->n, sizeof(depscan_entry)) != 0 ||
+            !(key = strmap_put(&cache->index, path, cache->n))){
+            if (data) munmap(data, st.st_size);
+            return NULL;
+        }
+        e = &cache->entries[cache->n++];
+        memset(e, 0, sizeof(*e));
+        e->path = key;
+        e->hash = ~h;
+    }
+
+    if (e->hash != h){
+        _depscan_clear_includes(e);
+        if (data) _depscan_parse(e, data, st.st_size);
+        e->hash = h;
+    }
+
+    e->dev = st.st_dev;
+    e->ino = st.st_ino;
+    e->size = st.st_size;
+    e->mtime = st.st_mtime;
+
+    if (data) munmap(data, st.st_size);
+    return e;
+}
+
+static int _depscan_try(const char *dir, const char *name, char *out, size_t out_sz){
+    struct stat st;
+    if (dir) snprintf(out, out_sz, "%s/%s", dir, name);
+    else     snprintf(out, out_sz, "%s", name);
+    return stat(out, &st) == 0 && S_ISREG(st.st_mode);
+}
+
+/*
+ * Resolves an include the way the compiler would for the tracked paths:
+ * quoted names look next to the including file and in the source directory
+ * first, then every include dir. Unresolved (system) headers are ignored.
+ */
+static int depscan_resolve(const compiler_conf *cfg, const char *from, const char *name,
+                           char angled, char *out, size_t out_sz){
+    if (name[0] == '/') return _depscan_try(NULL, name, out, out_sz);
+
+    if (!angled){
+        char *dir = get_dir_from_path(from);
+        int found = dir && _depscan_try(dir, name, out, out_sz);
+        free(dir);
+        if (found) return 1;
+        if (cfg->src_dir && _depscan_try(cfg->src_dir, name, out, out_sz)) return 1;
+    }
+
+    for (size_t i = 0; i < cfg->include_n; i++){
+        if (_depscan_try(cfg->include_dirs[i], name, out, out_sz)) return 1;
+    }
+    return 0;
+}
+
+typedef struct {
+    const char **paths;  // interned in `seen`
+    size_t       n;
+    abs_arena    arena;
+    abs_strtab   seen;
+} depscan_deps;
+
+static void _depscan_walk(const compiler_conf *cfg, const char *path, depscan_deps *deps){
+    depscan_entry *e = depscan_lookup(&abs_depscan_cache, path);
+    if (!e) return;
+    size_t idx = e - abs_depscan_cache.entries;
+
+    for (size_t i = 0; i < abs_depscan_cache.entries[idx].includes_n; i++){
+        e = &abs_depscan_cache.entries[idx];
+        char resolved[PATH_MAX];
+        if (!depscan_resolve(cfg, path, e->includes[i], e->angled[i], resolved, sizeof(resolved)))
+            continue;
+        if (strtab_find(&deps->seen, resolved)) continue;
+
+        const char *kept = strtab_intern(&deps->seen, resolved, strlen(resolved));
+        if (!kept || abs_grow(&deps->paths, deps->n, sizeof(char*)) != 0) return;
+        deps->paths[deps->n++] = kept;
+
+        // the cache may grow (and move) while walking, hence `idx`
+        _depscan_walk(cfg, deps->paths[deps->n - 1], deps);
+    }
+}
+
+// collects every tracked header reachable from `src`
+int depscan_collect(const compiler_conf *cfg, const char *src, depscan_deps *deps){
+    memset(deps, 0, sizeof(*deps));
+    deps->seen.arena = &deps->arena;
+    _depscan_walk(cfg, src, deps);
+    return 0;
+}
+
+void depscan_deps_free(depscan_deps *deps){
+    free(deps->paths);
+    strtab_free(&deps->seen);
+    arena_free(&deps->arena);
+    deps->paths = NULL;
+    deps->n = 0;
+}
+
+// returns the first header of `src` newer than `since`, or NULL
+const char *depscan_newer_header(const compiler_conf *cfg, const char *src, time_t since, depscan_deps *deps){
+    depscan_collect(cfg, src, deps);
+    for (size_t i = 0; i < deps->n; i++){
+        struct stat st;
+        if (stat(deps->paths[i], &st) == 0 && st.st_mtime > since)
+            return deps->paths[i];
+    }
+    return NULL;
+}
+
+void depscan_cache_free(depscan_cache *cache){
+    for (size_t i = 0; i < cache->n; i++) _depscan_clear_includes(&cache->entries[i]);
+    free(cache->entries);
+    strmap_free(&cache->index);
+    arena_free(&cache->arena);
+    cache->entries = NULL;
+    cache->n = 0;
+}
+
+#endif
+#define ABS_DEPSCAN
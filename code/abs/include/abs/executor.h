@@ -0,0 +1,302 @@
+#include "abs/colors.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/limits.h>
+#include <netdb.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#ifndef ABS_EXECUTOR
+
+/*
+ * Remote compile executor. A compile job preprocesses its source locally
+ * and hands the translation unit to `abs --remote-cc`, which ships it to
+ * one of the [executor] workers and writes back the object. Linking and
+ * preprocessing never leave the machine, so workers need nothing but a
+ * compiler.
+ *
+ * Wire protocol, one compile per connection. A blob is its decimal length,
+ * a newline, then that many bytes.
+ *   request:  `ABSX 1\n` argc `\n` argc x blob(arg) blob(preprocessed source)
+ *   response: `ABSX 1\n` status `\n` blob(diagnostics) blob(object)
+ * The worker appends `<input> -o <output>` to the argv it received, so the
+ * client ends argv with the language, e.g. `-c -x cpp-output`. argv[0] is
+ * the compiler's file name only, workers look it up in their own $PATH.
+ */
+
+#define ABS_EXEC_MAGIC    "ABSX 1\n"
+#define ABS_EXEC_MAX_BLOB (1024UL * 1024 * 1024)
+#define ABS_EXEC_MAX_ARGS 4096
+
+static int exec_write_blob(FILE *f, const void *data, size_t len){
+    if (fprintf(f, "%zu\n", len) < 0) return -1;
+    if (len && fwrite(data, 1, len, f) != len) return -1;
+    return 0;
+}
+
+// returns a malloc'd, NUL terminated copy of the blob, or NULL
+static char *exec_read_blob(FILE *f, size_t *len_out){
+    size_t len;
+    if (fscanf(f, "%zu", &len) != 1 || fgetc(f) != '\n' || len > ABS_EXEC_MAX_BLOB) return NULL;
+
+    char *data = malloc(len + 1);
+    if (!data) return NULL;
+    if (len && fread(data, 1, len, f) != len){
+        free(data);
+        return NULL;
+    }
+    data[len] = '\0';
+    if (len_out) *len_out = len;
+    return data;
+}
+
+static int exec_read_magic(FILE *f){
+    char magic[sizeof(ABS_EXEC_MAGIC)] = {0};
+    if (fread(magic, 1, sizeof(magic) - 1, f) != sizeof(magic) - 1) return -1;
+    return strcmp(magic, ABS_EXEC_MAGIC) == 0 ? 0 : -1;
+}
+
+static char *exec_read_file(const char *path, size_t *len_out){
+    FILE *f = fopen(path, "rb");
+    if (!f) return NULL;
+
+    fseek(f, 0, SEEK_END);
+    long len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    if (len < 0){
+        fclose(f);
+        return NULL;
+    }
+
+    char *data = malloc(len + 1);
+    if (data && fread(data, 1, len, f) != (size_t)len){
+        free(data);
+        data = NULL;
+    }
+    fclose(f);
+    if (data){
+        data[len] = '\0';
+        *len_out = len;
+    }
+    return data;
+}
+
+// writes through a temporary file so a failed transfer never leaves a partial object
+static int exec_write_file(const char *path, const char *data, size_t len){
+    char tmp[PATH_MAX + 16];
+    snprintf(tmp, sizeof(tmp), "%s.tmp%d", path, (int)getpid());
+
+    FILE *f = fopen(tmp, "wb");
+    if (!f) return -1;
+    int ok = (len == 0 || fwrite(data, 1, len, f) == len);
+    ok = (fclose(f) == 0) && ok;
+    if (!ok || rename(tmp, path) != 0){
+        unlink(tmp);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * `unix:PATH`, `tcp:PORT` (loopback) or `tcp:HOST:PORT`. With `listening`
+ * the socket is bound and listening, otherwise it is connected.
+ */
+static int executor_socket(const char *endpoint, bool listening){
+    if (strncmp(endpoint, "unix:", 5) == 0){
+        const char *path = endpoint + 5;
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (strlen(path) >= sizeof(addr.sun_path)) return -1;
+        memcpy(addr.sun_path, path, strlen(path));
+
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) return -1;
+        if (listening){
+            unlink(path);
+            if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, 64) != 0){
+                close(fd);
+                return -1;
+            }
+        } else if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0){
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    if (strncmp(endpoint, "tcp:", 4) != 0) return -1;
+
+    char host[256] = "127.0.0.1";
+    const char *port = endpoint + 4;
+    const char *colon = strrchr(port, ':');
+    if (colon){
+        snprintf(host, sizeof(host), "%.*s", (int)(colon - port), port);
+        port = colon + 1;
+    }
+
+    struct addrinfo hints, *res = NULL;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = listening ? AI_PASSIVE : 0;
+    if (getaddrinfo(host, port, &hints, &res) != 0) return -1;
+
+    int fd = -1;
+    for (struct addrinfo *ai = res; ai && fd < 0; ai = ai->ai_next){
+        fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+        if (fd < 0) continue;
+
+        int ok;
+        if (listening){
+            int one = 1;
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+            ok = bind(fd, ai->ai_addr, ai->ai_addrlen) == 0 && listen(fd, 64) == 0;
+        } else {
+            ok = connect(fd, ai->ai_addr, ai->ai_addrlen) == 0;
+        }
+        if (!ok){
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(res);
+    return fd;
+}
+
+// the running abs binary, so generated job commands can call back into it
+int executor_self_path(char *out, size_t out_sz){
+    ssize_t len = readlink("/proc/self/exe", out, out_sz - 1);
+    if (len <= 0) return -1;
+    out[len] = '\0';
+    return 0;
+}
+
+/*
+ * One compile on one worker. Returns the compiler's exit status, or -1
+ * when the worker could not be reached or the transfer broke.
+ */
+static int executor_send(const char *endpoint, const char *src, size_t src_len,
+                         int argc, const char **argv, const char *out_path){
+    int fd = executor_socket(endpoint, false);
+    if (fd < 0) return -1;
+
+    FILE *w = fdopen(dup(fd), "w");
+    FILE *r = fdopen(fd, "r");
+    if (!w || !r){
+        if (w) fclose(w);
+        if (r) fclose(r); else close(fd);
+        return -1;
+    }
+
+    int ok = fputs(ABS_EXEC_MAGIC, w) >= 0 && fprintf(w, "%d\n", argc) > 0;
+    for (int i = 0; ok && i < argc; i++){
+        // workers find the compiler on their own $PATH and refuse paths
+        const char *arg = argv[i], *slash = i == 0 ? strrchr(arg, '/') : NULL;
+        if (slash) arg = slash + 1;
+        ok = exec_write_blob(w, arg, strlen(arg)) == 0;
+    }
+    ok = ok && exec_write_blob(w, src, src_len) == 0;
+    ok = (fclose(w) == 0) && ok;
+    shutdown(fileno(r), SHUT_WR);
+
+    int status = -1;
+    if (ok && exec_read_magic(r) == 0 && fscanf(r, "%d", &status) == 1 && fgetc(r) == '\n'){
+        size_t diag_len = 0, obj_len = 0;
+        char *diag = exec_read_blob(r, &diag_len);
+        char *obj = diag ? exec_read_blob(r, &obj_len) : NULL;
+
+        if (!diag || !obj) status = -1;
+        else {
+            fwrite(diag, 1, diag_len, stderr);
+            if (status == 0 && exec_write_file(out_path, obj, obj_len) != 0){
+                fprintf(stderr, "%s[remote]%s cannot write %s\n", abs_fore.red, abs_fore.normal, out_path);
+                status = 1;
+            }
+        }
+        free(diag);
+        free(obj);
+    } else {
+        status = -1;
+    }
+    fclose(r);
+    return status;
+}
+
+/*
+ * `abs --remote-cc INPUT OUTPUT -- CC ARGS...`, run inside compile jobs.
+ * Workers come from $ABS_WORKERS; the first one tried is picked by the
+ * output name so repeated builds spread the same way. When no worker
+ * answers, the compile runs locally.
+ */
+int executor_remote_compile(int argc, const char **argv){
+    if (argc < 4 || strcmp(argv[2], "--") != 0){
+        fprintf(stderr, "usage: abs --remote-cc INPUT OUTPUT -- CC ARGS...\n");
+        return 2;
+    }
+    const char *in_path = argv[0], *out_path = argv[1];
+    int cc_argc = argc - 3;
+    const char **cc_argv = argv + 3;
+
+    size_t src_len = 0;
+    char *src = exec_read_file(in_path, &src_len);
+    if (!src){
+        fprintf(stderr, "%s[remote]%s cannot read %s\n", abs_fore.red, abs_fore.normal, in_path);
+        return 1;
+    }
+
+    const char *env = getenv("ABS_WORKERS");
+    char *workers = strdup(env ? env : "");
+    char *list[256];
+    size_t n = 0;
+    char *saveptr = NULL;
+    for (char *tok = strtok_r(workers, " ", &saveptr); tok && n < 256; tok = strtok_r(NULL, " ", &saveptr))
+        list[n++] = tok;
+
+    uint64_t h = 1469598103934665603ULL;
+    for (const char *p = out_path; *p; p++) h = (h ^ (unsigned char)*p) * 1099511628211ULL;
+
+    int status = -1;
+    for (size_t k = 0; k < n && status < 0; k++){
+        const char *endpoint = list[(h + k) % n];
+        status = executor_send(endpoint, src, src_len, cc_argc, cc_argv, out_path);
+        if (status < 0)
+            fprintf(stderr, "%s[remote]%s worker %s unavailable\n", abs_fore.yellow, abs_fore.normal, endpoint);
+    }
+    free(workers);
+    free(src);
+
+    if (status >= 0) return status;
+
+    // every worker is down; compile here with the same arguments
+    const char **local = malloc(sizeof(char*) * (cc_argc + 4));
+    if (!local) return 1;
+    for (int i = 0; i < cc_argc; i++) local[i] = cc_argv[i];
+    local[cc_argc] = in_path;
+    local[cc_argc + 1] = "-o";
+    local[cc_argc + 2] = out_path;
+    local[cc_argc + 3] = NULL;
+
+    pid_t pid = fork();
+    if (pid == 0){
+        execvp(local[0], (char *const *)local);
+        _exit(127);
+    }
+    free(local);
+    if (pid < 0) return 1;
+
+    int wstatus;
+    while (waitpid(pid, &wstatus, 0) < 0 && errno == EINTR);
+    return WIFEXITED(wstatus) ? WEXITSTATUS(wstatus) : 1;
+}
+
+#endif
+#define ABS_EXECUTOR
@@ -0,0 +1,213 @@
+#include "configuration.h"
+#include "depscan.h"
+#include "jobs.h"
+#include <sys/stat.h>
+
+#ifndef ABS_GENERATE
+
+/*
+ * [generate.NAME] rules. A rule runs, as a job of its own, when an output
+ * is missing, an input is newer than the outputs or the command changed.
+ * Compiles wait only for the rules they need: a generated source for its
+ * rule, a source including a generated header for that header's rule.
+ * Objects built from regenerated files are recompiled in the same run.
+ *
+ * Rules are shared by every --modes configuration, so their signatures
+ * live in <objects>/generate of the base configuration.
+ */
+
+typedef struct {
+    long  *job_of;          // per rule, -1 when up to date
+    bool   headers_missing; // a running rule creates headers that do not exist yet
+    dev_t *header_dev;      // existing non-source outputs of running rules
+    ino_t *header_ino;
+    size_t *header_rule;
+    size_t headers_n;
+} gen_plan;
+
+static void _generate_sig_path(const compiler_conf *cfg, const gen_rule *rule, char *out, size_t out_sz){
+    size_t len = strlen(cfg->obj_dir), tag = cfg->mode_tag ? strlen(cfg->mode_tag) : 0;
+    if (tag && len > tag && cfg->obj_dir[len - tag - 1] == '/') len -= tag + 1;
+    snprintf(out, out_sz, "%.*s/generate/%s.sig", (int)len, cfg->obj_dir, rule->name);
+}
+
+static uint64_t _generate_signature(const gen_rule *rule){
+    uint64_t h = depscan_hash(rule->command, strlen(rule->command));
+    for (size_t i = 0; i < rule->outputs_n; i++)
+        h ^= depscan_hash(rule->outputs[i], strlen(rule->outputs[i])) * (i + 3);
+    return h;
+}
+
+// fills `why` when the rule has to run
+static int _generate_stale(const gen_rule *rule, const char *sig_path, uint64_t sig, char *why, size_t why_sz){
+    FILE *f = fopen(sig_path, "r");
+    unsigned long long old = 0;
+    int have_sig = f && fscanf(f, "%llx", &old) == 1;
+    if (f) fclose(f);
+    if (!have_sig){
+        snprintf(why, why_sz, "never generated");
+        return 1;
+    }
+    if (old != sig){
+        snprintf(why, why_sz, "command changed");
+        return 1;
+    }
+
+    // a generator that keeps identical outputs leaves their mtime, the signature says when it ran
+    struct stat st;
+    time_t built = stat(sig_path, &st) == 0 ? st.st_mtime : 0;
+    for (size_t i = 0; i < rule->outputs_n; i++){
+        if (stat(rule->outputs[i], &st) != 0){
+            snprintf(why, why_sz, "%s missing", rule->outputs[i]);
+            return 1;
+        }
+        if (st.st_mtime > built) built = st.st_mtime;
+    }
+    for (size_t i = 0; i < rule->inputs_n; i++){
+        if (stat(rule->inputs[i], &st) == 0 && st.st_mtime > built){
+            snprintf(why, why_sz, "%s changed", rule->inputs[i]);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static long _generate_find_job(const job_list *jobs, const char *label){
+    for (size_t i = 0; i < jobs->n; i++){
+        if (jobs->jobs[i].kind == JOB_GENERATE && strcmp(jobs->jobs[i].label, label) == 0) return (long)i;
+    }
+    return -1;
+}
+
+/*
+ * Adds a job for every stale rule, or finds the one an earlier mode
+ * added. Returns -1 only when out of memory.
+ */
+int generate_emit_jobs(int force_recompile, const compiler_conf *cfg, job_list *jobs, gen_plan *plan){
+    memset(plan, 0, sizeof(*plan));
+    if (cfg->generators_n == 0) return 0;
+    plan->job_of = malloc(sizeof(long) * cfg->generators_n);
+    if (!plan->job_of) return -1;
+
+    for (size_t r = 0; r < cfg->generators_n; r++){
+        const gen_rule *rule = &cfg->generators[r];
+        char label[PATH_MAX];
+        snprintf(label, sizeof(label), "generate.%s", rule->name);
+        plan->job_of[r] = _generate_find_job(jobs, label);
+
+        char sig_path[PATH_MAX + 32], why[PATH_MAX + 64];
+        _generate_sig_path(cfg, rule, sig_path, sizeof(sig_path));
+        uint64_t sig = _generate_signature(rule);
+        if (force_recompile) snprintf(why, sizeof(why), "forced with -r");
+        if (plan->job_of[r] < 0 && (force_recompile || _generate_stale(rule, sig_path, sig, why, sizeof(why)))){
+            if (!cfg->progress || cfg->explain)
+                printf("%s[generate]%s %s (%s)\n", abs_fore.green, abs_fore.normal, rule->name, why);
+
+            char cmd[16384];
+            size_t pos = snprintf(cmd, sizeof(cmd), "mkdir -p \"%.*s\"",
+                                  (int)(strrchr(sig_path, '/') - sig_path), sig_path);
+            for (size_t o = 0; o < rule->outputs_n; o++){
+                char *out_dir = get_dir_from_path(rule->outputs[o]);
+                if (out_dir) pos += snprintf(cmd + pos, sizeof(cmd) - pos, " \"%s\"", out_dir);
+                free(out_dir);
+            }
+            pos += snprintf(cmd + pos, sizeof(cmd) - pos, " && ( %s ) && echo %016llx > \"%s\" ",
+                            rule->command, (unsigned long long)sig, sig_path);
+            if (pos >= sizeof(cmd)){
+                fprintf(stderr, "%s[error]%s [generate.%s] command too long\n", abs_fore.red, abs_fore.normal, rule->name);
+                return -1;
+            }
+
+            plan->job_of[r] = jobs_add(jobs, JOB_GENERATE, label, cmd, NULL, sig_path);
+            if (plan->job_of[r] < 0) return -1;
+        } else if (plan->job_of[r] < 0 && !cfg->progress){
+            printf("%s[skip]%s %s (up to date)\n", abs_fore.cyan, abs_fore.normal, label);
+        }
+        if (plan->job_of[r] < 0) continue;
+
+        // what this run regenerates, to find the objects that include it
+        for (size_t o = 0; o < rule->outputs_n; o++){
+            struct stat st;
+            if (is_compiled_source(rule->outputs[o])) continue;
+            if (stat(rule->outputs[o], &st) != 0){
+                plan->headers_missing = true;
+                continue;
+            }
+            size_t n = plan->headers_n;
+            if (abs_grow(&plan->header_dev, n, sizeof(dev_t)) != 0 ||
+                abs_grow(&plan->header_ino, n, sizeof(ino_t)) != 0 ||
+                abs_grow(&plan->header_rule, n, sizeof(size_t)) != 0) return -1;
+            plan->header_dev[n] = st.st_dev;
+            plan->header_ino[n] = st.st_ino;
+            plan->header_rule[n] = r;
+            plan->headers_n++;
+        }
+    }
+    return 0;
+}
+
+// the rule generating source `src` (relative to [dirs] src), or -1
+static long _generate_rule_of(const compiler_conf *cfg, const char *src_full_path){
+    for (size_t r = 0; r < cfg->generators_n; r++){
+        const gen_rule *rule = &cfg->generators[r];
+        for (size_t o = 0; o < rule->outputs_n; o++){
+            const char *a = rule->outputs[o], *b = src_full_path;
+            while (a[0] == '.' && a[1] == '/') a += 2;
+            while (b[0] == '.' && b[1] == '/') b += 2;
+            if (strcmp(a, b) == 0) return (long)r;
+        }
+    }
+    return -1;
+}
+
+/*
+ * Makes the compile of `src_full_path` wait for the rules it needs. When
+ * called before the object is planned (`job` < 0) it only fills `why`
+ * and returns 1 if a rule that runs regenerates the source or one of its
+ * headers, so the object must be rebuilt.
+ */
+int generate_depend(const compiler_conf *cfg, const gen_plan *plan, const char *src_full_path,
+                    job_list *jobs, long job, char *why, size_t why_sz){
+    if (!plan->job_of) return 0;
+    int needed = 0;
+
+    long rule = _generate_rule_of(cfg, src_full_path);
+    if (rule >= 0 && plan->job_of[rule] >= 0){
+        if (job >= 0) jobs_depend(jobs, job, plan->job_of[rule]);
+        else snprintf(why, why_sz, "generated by %s", cfg->generators[rule].name);
+        needed = 1;
+    }
+
+    if (plan->headers_n){
+        depscan_deps deps;
+        depscan_collect(cfg, src_full_path, &deps);
+        for (size_t d = 0; d < deps.n; d++){
+            struct stat st;
+            if (stat(deps.paths[d], &st) != 0) continue;
+            for (size_t h = 0; h < plan->headers_n; h++){
+                if (plan->header_dev[h] != st.st_dev || plan->header_ino[h] != st.st_ino) continue;
+                if (job >= 0) jobs_depend(jobs, job, plan->job_of[plan->header_rule[h]]);
+                else if (!needed) snprintf(why, why_sz, "generated header %s", deps.paths[d]);
+                needed = 1;
+            }
+        }
+        depscan_deps_free(&deps);
+    }
+
+    // with headers not written yet, nobody can tell who includes them
+    for (size_t r = 0; job >= 0 && plan->headers_missing && r < cfg->generators_n; r++){
+        if (plan->job_of[r] >= 0) jobs_depend(jobs, job, plan->job_of[r]);
+    }
+    return needed;
+}
+
+void generate_plan_free(gen_plan *plan){
+    free(plan->job_of);
+    free(plan->header_dev);
+    free(plan->header_ino);
+    free(plan->header_rule);
+    memset(plan, 0, sizeof(*plan));
+}
+
+#endif
+#define ABS_GENERATE
@@ -0,0 +1,224 @@
+#include "compilation.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifndef ABS_INSTALL
+
+/*
+ * `abs install`. Artifacts listed in [install] bin, lib and include go
+ * to the matching directory under `prefix` (after $DESTDIR, for staging).
+ * A file whose size and mtime match the installed copy is skipped, as is
+ * one whose bytes match; anything else is cloned (FICLONE) or copied in
+ * the kernel (copy_file_range) into a temporary file next to the target
+ * and renamed over it, so readers never see a half-written binary.
+ * Symlinks are installed as symlinks with the same target, after the
+ * files, which keeps `libfoo.so -> libfoo.so.1 -> libfoo.so.1.2` chains.
+ */
+
+typedef struct {
+    size_t installed;
+    size_t unchanged;
+    size_t failed;
+} install_counts;
+
+// same size and contents; `a` and `b` are open for reading
+static bool _install_same_content(int a, int b, off_t size){
+    char buf_a[65536], buf_b[65536];
+    for (off_t done = 0; done < size; ){
+        ssize_t ra = pread(a, buf_a, sizeof(buf_a), done);
+        if (ra <= 0 || pread(b, buf_b, ra, done) != ra || memcmp(buf_a, buf_b, ra) != 0) return false;
+        done += ra;
+    }
+    return true;
+}
+
+// reflink when the filesystem shares extents, else an in-kernel copy, else read/write
+static int _install_copy_data(int in, int out, off_t size){
+    if (ioctl(out, FICLONE, in) == 0) return 0;
+
+    off_t done = 0;
+    while (done < size){
+        ssize_t n = copy_file_range(in, NULL, out, NULL, size - done, 0);
+        if (n <= 0) break;
+        done += n;
+    }
+    if (done == size) return 0;
+
+    char buf[65536];
+    if (lseek(in, done, SEEK_SET) < 0 || lseek(out, done, SEEK_SET) < 0) return -1;
+    ssize_t r;
+    while ((r = read(in, buf, sizeof(buf))) > 0){
+        if (write(out, buf, r) != r) return -1;
+    }
+    return r < 0 ? -1 : 0;
+}
+
+static int _install_tmp_path(const char *dst, char *tmp, size_t tmp_sz){
+    return snprintf(tmp, tmp_sz, "%s.abs-tmp%d", dst, (int)getpid()) < (int)tmp_sz ? 0 : -1;
+}
+
+// returns 1 when installed, 0 when already up to date, -1 on failure
+static int install_file(const char *src, const char *dst){
+    int in = open(src, O_RDONLY | O_CLOEXEC);
+    if (in < 0) return -1;
+
+    struct stat st, dst_st;
+    if (fstat(in, &st) != 0){
+        close(in);
+        return -1;
+    }
+
+    if (stat(dst, &dst_st) == 0 && S_ISREG(dst_st.st_mode) && dst_st.st_size == st.st_size){
+        bool same = dst_st.st_mtim.tv_sec == st.st_mtim.tv_sec && dst_st.st_mtim.tv_nsec == st.st_mtim.tv_nsec;
+        if (!same){
+            int old = open(dst, O_RDONLY | O_CLOEXEC);
+            same = old >= 0 && _install_same_content(in, old, st.st_size);
+            if (old >= 0) close(old);
+        }
+        if (same){
+            close(in);
+            return 0;
+        }
+    }
+
+    char tmp[PATH_MAX + 32];
+    if (_install_tmp_path(dst, tmp, sizeof(tmp)) != 0){
+        close(in);
+        return -1;
+    }
+    int out = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, st.st_mode & 07777);
+    if (out < 0){
+        close(in);
+        return -1;
+    }
+
+    // the source's mtime goes along, so the next run takes the fast path
+    struct timespec times[2] = { st.st_atim, st.st_mtim };
+    int r = _install_copy_data(in, out, st.st_size);
+    if (r == 0) r = fchmod(out, st.st_mode & 07777);
+    if (r == 0) r = futimens(out, times);
+    if (close(out) != 0) r = -1;
+    close(in);
+
+    if (r != 0 || rename(tmp, dst) != 0){
+        unlink(tmp);
+        return -1;
+    }
+    return 1;
+}
+
+static int install_symlink(const char *src, const char *dst){
+    char target[PATH_MAX], old[PATH_MAX];
+    ssize_t n = readlink(src, target, sizeof(target) - 1);
+    if (n < 0) return -1;
+    target[n] = '\0';
+
+    ssize_t o = readlink(dst, old, sizeof(old) - 1);
+    if (o == n && memcmp(old, target, n) == 0) return 0;
+
+    char tmp[PATH_MAX + 32];
+    if (_install_tmp_path(dst, tmp, sizeof(tmp)) != 0) return -1;
+    unlink(tmp);
+    if (symlink(target, tmp) != 0) return -1;
+    if (rename(tmp, dst) != 0){
+        unlink(tmp);
+        return -1;
+    }
+    return 1;
+}
+
+static void _install_report(install_counts *c, const char *src, const char *dst, int r){
+    if (r > 0){
+        printf("%s[install]%s %s -> %s\n", abs_fore.green, abs_fore.normal, src, dst);
+        c->installed++;
+    } else if (r == 0){
+        c->unchanged++;
+    } else {
+        fprintf(stderr, "%s[install]%s %s -> %s: %s\n", abs_fore.red, abs_fore.normal, src, dst, strerror(errno));
+        c->failed++;
+    }
+}
+
+// one kind (bin, lib, include); regular files first so no symlink dangles meanwhile
+static void install_list(const char *prefix, const char *kind, char **paths, size_t paths_n,
+                         install_counts *c){
+    if (paths_n == 0) return;
+    char dir[PATH_MAX];
+    snprintf(dir, sizeof(dir), "%s/%s", prefix, kind);
+    mkdir_p(dir);
+
+    for (int links = 0; links < 2; links++){
+        for (size_t i = 0; i < paths_n; i++){
+            struct stat st;
+            if (lstat(paths[i], &st) != 0){
+                if (!links) _install_report(c, paths[i], dir, -1);
+                continue;
+            }
+            if (S_ISLNK(st.st_mode) != (links == 1) || S_ISDIR(st.st_mode)) continue;
+
+            const char *base = strrchr(paths[i], '/');
+            char dst[PATH_MAX * 2];
+            snprintf(dst, sizeof(dst), "%s/%s", dir, base ? base + 1 : paths[i]);
+            _install_report(c, paths[i], dst, links ? install_symlink(paths[i], dst) : install_file(paths[i], dst));
+        }
+    }
+}
+
+/*
+ * Installs the artifacts of an already built config. Without bin, lib or
+ * include the build output itself is installed, to lib for libraries.
+ * Returns the number of failed files, or -1 when there is no prefix.
+ */
+int install_run(ini_config *ini){
+    char *prefix = expand_env(ini_get_at(ini, "install", "prefix"));
+    if (!prefix || !*prefix){
+        fprintf(stderr, "%s[error]%s no [install] prefix configured\n", abs_fore.red, abs_fore.normal);
+        free(prefix);
+        return -1;
+    }
+    char root[PATH_MAX];
+    const char *destdir = getenv("DESTDIR");
+    snprintf(root, sizeof(root), "%s%s", destdir ? destdir : "", prefix);
+    free(prefix);
+
+    static const char *kinds[] = { "bin", "lib", "include" };
+    char **paths[3] = {0};
+    size_t paths_n[3] = {0};
+    bool listed = false;
+    for (int k = 0; k < 3; k++){
+        const char *list = ini_get_at(ini, "install", kinds[k]);
+        if (!list) continue;
+        listed = true;
+        expand_sources(NULL, list, &paths[k], &paths_n[k]);
+    }
+
+    if (!listed && ini_check(ini, "files") == 0){
+        compiler_conf cfg = {0};
+        if (config_ini_parse(ini, &cfg) == 0){
+            char out_path[PATH_MAX];
+            get_output_path(&cfg, out_path, sizeof(out_path));
+            int k = strcmp(cfg.build_type, "binary") == 0 ? 0 : 1;
+            _cfg_append_str(&paths[k], &paths_n[k], out_path);
+        }
+        cfg.cleanup = false;
+        compiler_conf_free(&cfg);
+    }
+
+    install_counts counts = {0};
+    for (int k = 0; k < 3; k++){
+        install_list(root, kinds[k], paths[k], paths_n[k], &counts);
+        for (size_t i = 0; i < paths_n[k]; i++) free(paths[k][i]);
+        free(paths[k]);
+    }
+
+    printf("%s[install]%s %s: %zu installed, %zu unchanged, %zu failed\n", abs_fore.blue, abs_fore.normal,
+           root, counts.installed, counts.unchanged, counts.failed);
+    return (int)counts.failed;
+}
+
+#endif
+#define ABS_INSTALL
@@ -0,0 +1,700 @@
+#include "abs/colors.h"
+#include "arena.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/limits.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifndef ABS_JOBS
+
+/*
+ * Build jobs. Every compile and link is a separate shell command with an
+ * explicit list of jobs it depends on, so a failure only blocks the jobs
+ * that actually need its output.
+ */
+
+typedef enum {
+    JOB_COMPILE,
+    JOB_LINK,
+    JOB_TEST,
+    JOB_GENERATE,    // a [generate.*] rule
+} job_kind;
+
+typedef enum {
+    JOB_PENDING,
+    JOB_RUNNING,
+    JOB_OK,
+    JOB_FAILED,
+    JOB_SKIPPED,     // a dependency failed or the build stopped first
+} job_state;
+
+// how jobs_run reports jobs as they finish
+typedef enum {
+    JOBS_OUTPUT_PLAIN,      // each job's captured output, nothing else
+    JOBS_OUTPUT_LINES,      // one `[done/total] kind label (time)` line per job, for logs and CI
+    JOBS_OUTPUT_STATUS,     // one status line redrawn in place, for terminals
+} jobs_output;
+
+static const char *jobs_output_names[] = { "plain", "lines", "status" };
+
+typedef struct {
+    job_kind  kind;
+    job_state state;
+    char     *label;
+    char     *cmd;
+    char     *log_path;     // captured stdout/stderr when capturing
+    char     *invalidate;   // removed when the job fails (e.g. its signature)
+
+    size_t   *deps;
+    size_t    deps_n;
+    size_t    deps_ok;      // leading deps known to have succeeded
+
+    pid_t     pid;
+    int       pidfd;        // -1 when the kernel has no pidfd_open
+    int       status;
+
+    struct timespec started;    // CLOCK_MONOTONIC
+    struct timespec finished;
+    struct rusage   usage;      // from wait4, includes the commands the shell waited for
+    long      estimate_ms;  // recorded duration of the last run, -1 when unknown
+
+    /*
+     * Early cutoff. A job with an `output` that finishes with that file's
+     * mtime unchanged (the command kept the old, identical file) counts as
+     * `unchanged`. A `cutoff` job whose dependencies are all unchanged is
+     * not run at all and is unchanged itself.
+     */
+    char     *output;
+    struct timespec output_mtime;
+    bool      cutoff;
+    bool      unchanged;
+} abs_job;
+
+typedef struct job_list job_list;
+
+// called when a job starts, finishes or is skipped
+typedef void (*job_event_fn)(const job_list *jl, size_t job, void *user);
+
+struct job_list {
+    abs_job *jobs;
+    size_t   n;
+
+    char   **env;           // `NAME=VALUE` set in every job's environment
+    size_t   env_n;
+
+    bool     quiet;         // capture every job's output to its log, never print it
+    jobs_output output;
+    job_event_fn on_event;
+    void    *user;
+};
+
+void jobs_init(job_list *jl){
+    memset(jl, 0, sizeof(*jl));
+}
+
+static char *_jobs_strdup(const char *s){
+    return s ? strdup(s) : NULL;
+}
+
+// returns the index of the new job, or -1
+long jobs_add(job_list *jl, job_kind kind, const char *label, const char *cmd,
+              const char *log_path, const char *invalidate){
+    if (abs_grow(&jl->jobs, jl->n, sizeof(abs_job)) != 0) return -1;
+
+    abs_job *j = &jl->jobs[jl->n];
+    memset(j, 0, sizeof(*j));
+    j->kind = kind;
+    j->state = JOB_PENDING;
+    j->label = _jobs_strdup(label);
+    j->cmd = _jobs_strdup(cmd);
+    j->log_path = _jobs_strdup(log_path);
+    j->invalidate = _jobs_strdup(invalidate);
+    j->pid = -1;
+    j->pidfd = -1;
+    j->status = -1;
+    j->estimate_ms = -1;
+
+    return (long)jl->n++;
+}
+
+// `on` must be an earlier job, so a single forward pass schedules the list
+int jobs_depend(job_list *jl, size_t job, size_t on){
+    if (on >= job) return -1;
+    abs_job *j = &jl->jobs[job];
+    if (abs_grow(&j->deps, j->deps_n, sizeof(size_t)) != 0) return -1;
+    j->deps[j->deps_n++] = on;
+    return 0;
+}
+
+void jobs_restat(job_list *jl, size_t job, const char *output){
+    free(jl->jobs[job].output);
+    jl->jobs[job].output = _jobs_strdup(output);
+}
+
+int jobs_setenv(job_list *jl, const char *name, const char *value){
+    if (!value) return 0;
+    char **tmp = realloc(jl->env, sizeof(char*) * (jl->env_n + 1));
+    if (!tmp) return -1;
+    jl->env = tmp;
+
+    size_t len = strlen(name) + strlen(value) + 2;
+    jl->env[jl->env_n] = malloc(len);
+    if (!jl->env[jl->env_n]) return -1;
+    snprintf(jl->env[jl->env_n++], len, "%s=%s", name, value);
+    return 0;
+}
+
+// the whole list as one `&&` chain, for display
+size_t jobs_format(const job_list *jl, char *out_buf, size_t out_sz){
+    size_t pos = 0;
+    for (size_t i = 0; i < jl->env_n && pos < out_sz; i++){
+        pos += snprintf(out_buf + pos, out_sz - pos, "%s ", jl->env[i]);
+    }
+    for (size_t i = 0; i < jl->n && pos < out_sz; i++){
+        pos += snprintf(out_buf + pos, out_sz - pos, "%s%s", i ? "&& " : "", jl->jobs[i].cmd);
+    }
+    if (jl->n == 0 && pos < out_sz){
+        pos += snprintf(out_buf + pos, out_sz - pos, "true");
+    }
+    return pos;
+}
+
+static pid_t _jobs_spawn(const job_list *jl, abs_job *j, bool capture){
+    fflush(stdout);
+    fflush(stderr);
+
+    pid_t pid = fork();
+    if (pid != 0) return pid;
+
+    for (size_t i = 0; i < jl->env_n; i++) putenv(jl->env[i]);
+
+    if (capture && j->log_path){
+        int fd = open(j->log_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd >= 0){
+            dup2(fd, STDOUT_FILENO);
+            dup2(fd, STDERR_FILENO);
+            close(fd);
+        }
+    }
+
+    execl("/bin/sh", "sh", "-c", j->cmd, (char*)NULL);
+    _exit(127);
+}
+
+static void _jobs_print_log(const abs_job *j, const char *indent){
+    if (!j->log_path) return;
+    FILE *f = fopen(j->log_path, "r");
+    if (!f) return;
+
+    char line[4096];
+    while (fgets(line, sizeof(line), f)){
+        printf("%s%s", indent, line);
+        if (!strchr(line, '\n')) putchar('\n');
+    }
+    fclose(f);
+}
+
+// 1 - ready, 0 - waiting, -1 - can never run
+static int _jobs_ready(const job_list *jl, abs_job *j){
+    // a finished dependency stays finished, so checking resumes where it stopped
+    for (; j->deps_ok < j->deps_n; j->deps_ok++){
+        job_state s = jl->jobs[j->deps[j->deps_ok]].state;
+        if (s == JOB_FAILED || s == JOB_SKIPPED) return -1;
+        if (s != JOB_OK) return 0;
+    }
+    return 1;
+}
+
+static bool _jobs_finished(const abs_job *j){
+    return j->state != JOB_PENDING && j->state != JOB_RUNNING;
+}
+
+static struct timespec _jobs_mtime(const char *path){
+    struct stat st;
+    struct timespec none = {0, 0};
+    return stat(path, &st) == 0 ? st.st_mtim : none;
+}
+
+// true when a cutoff job has nothing new to work with
+static bool _jobs_cut_off(const job_list *jl, const abs_job *j){
+    if (!j->cutoff || j->deps_n == 0) return false;
+    for (size_t d = 0; d < j->deps_n; d++){
+        if (!jl->jobs[j->deps[d]].unchanged) return false;
+    }
+    return true;
+}
+
+static void _jobs_event(const job_list *jl, size_t job){
+    if (jl->on_event) jl->on_event(jl, job, jl->user);
+}
+
+// wall time of a finished job
+long jobs_elapsed_ms(const abs_job *j){
+    return (j->finished.tv_sec - j->started.tv_sec) * 1000L +
+           (j->finished.tv_nsec - j->started.tv_nsec) / 1000000L;
+}
+
+const char *jobs_kind_name(job_kind kind){
+    switch (kind){
+        case JOB_COMPILE: return "compile";
+        case JOB_LINK:    return "link";
+        case JOB_TEST:    return "test";
+        case JOB_GENERATE: return "generate";
+    }
+    return "job";
+}
+
+static double _jobs_now_ms(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+// one write(2), so a job's output lands in one piece whatever else prints
+static void _jobs_write(const char *buf, size_t len){
+    fflush(stdout);
+    while (len > 0){
+        ssize_t w = write(STDOUT_FILENO, buf, len);
+        if (w < 0 && errno == EINTR) continue;
+        if (w <= 0) return;
+        buf += w;
+        len -= w;
+    }
+}
+
+// `header` followed by the job's captured output, ending in a newline
+static void _jobs_flush_log(const abs_job *j, const char *header){
+    size_t hlen = strlen(header), len = 0;
+    struct stat st;
+    int fd = j->log_path ? open(j->log_path, O_RDONLY | O_CLOEXEC) : -1;
+    if (fd >= 0 && fstat(fd, &st) == 0) len = st.st_size;
+
+    char *buf = malloc(hlen + len + 1);
+    if (!buf){
+        if (fd >= 0) close(fd);
+        return;
+    }
+    memcpy(buf, header, hlen);
+    size_t got = 0;
+    while (fd >= 0 && got < len){
+        ssize_t r = read(fd, buf + hlen + got, len - got);
+        if (r <= 0) break;
+        got += r;
+    }
+    if (fd >= 0) close(fd);
+    if (got && buf[hlen + got - 1] != '\n') buf[hlen + got++] = '\n';
+    _jobs_write(buf, hlen + got);
+    free(buf);
+}
+
+static bool _jobs_log_empty(const abs_job *j){
+    struct stat st;
+    return !j->log_path || stat(j->log_path, &st) != 0 || st.st_size == 0;
+}
+
+/*
+ * Progress of one jobs_run. The ETA is the recorded work left spread over
+ * the parallel slots; jobs never timed count as the average of those that
+ * were, or of what finished so far in this run.
+ */
+typedef struct {
+    size_t done;
+    double known_ms;        // estimates of the unfinished jobs that have one
+    size_t unknown;         // unfinished jobs without an estimate
+    double mean_ms;         // of the recorded estimates, 0 when there are none
+    double ran_ms;          // jobs that finished in this run
+    size_t ran;
+    double drawn_ms;
+    bool   shown;           // the status line is on the screen
+} _jobs_progress;
+
+static void _jobs_progress_init(const job_list *jl, _jobs_progress *p){
+    memset(p, 0, sizeof(*p));
+    size_t known = 0;
+    for (size_t i = 0; i < jl->n; i++){
+        const abs_job *j = &jl->jobs[i];
+        if (_jobs_finished(j)) p->done++;
+        else if (j->estimate_ms >= 0){
+            p->known_ms += j->estimate_ms;
+            known++;
+        } else p->unknown++;
+    }
+    if (known) p->mean_ms = p->known_ms / known;
+}
+
+static void _jobs_progress_done(_jobs_progress *p, const abs_job *j){
+    p->done++;
+    if (j->estimate_ms >= 0) p->known_ms -= j->estimate_ms;
+    else if (p->unknown) p->unknown--;
+    if (j->state == JOB_OK && j->started.tv_sec){
+        p->ran_ms += jobs_elapsed_ms(j);
+        p->ran++;
+    }
+}
+
+static void _jobs_status_clear(_jobs_progress *p){
+    if (!p->shown) return;
+    _jobs_write("\r\033[K", 4);
+    p->shown = false;
+}
+
+// redrawn at most every 100ms unless `force`
+static void _jobs_status(const job_list *jl, _jobs_progress *p, int parallel, size_t first, bool force){
+    double now = _jobs_now_ms();
+    if (!force && p->shown && now - p->drawn_ms < 100) return;
+    p->drawn_ms = now;
+
+    double mean = p->mean_ms > 0 ? p->mean_ms : (p->ran ? p->ran_ms / p->ran : -1);
+    double left = p->known_ms + (mean > 0 ? mean * p->unknown : 0);
+    size_t running = 0;
+    const abs_job *oldest = NULL;
+    for (size_t i = first; i < jl->n && running < (size_t)parallel; i++){
+        const abs_job *j = &jl->jobs[i];
+        if (j->state != JOB_RUNNING) continue;
+        running++;
+        double est = j->estimate_ms >= 0 ? j->estimate_ms : mean;
+        double elapsed = now - (j->started.tv_sec * 1000.0 + j->started.tv_nsec / 1e6);
+        left -= elapsed < est ? elapsed : est;
+        if (!oldest) oldest = j;
+    }
+
+    char eta[32] = "";
+    if (mean > 0 || p->unknown == 0){
+        long s = (long)(left > 0 ? left / (parallel > 0 ? parallel : 1) / 1000.0 + 0.5 : 0);
+        snprintf(eta, sizeof(eta), ", ETA %ld:%02ld", s / 60, s % 60);
+    }
+
+    struct winsize ws;
+    size_t width = ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0 && ws.ws_col ? ws.ws_col : 80;
+    char line[1024];
+    int len = snprintf(line, sizeof(line), "[%zu/%zu] %zu running%s  %s", p->done, jl->n, running, eta,
+                       oldest ? oldest->label : "");
+    if (len < 0) return;
+    if ((size_t)len >= sizeof(line)) len = sizeof(line) - 1;
+    if ((size_t)len >= width) len = width - 1;
+
+    char out[1200];
+    int olen = snprintf(out, sizeof(out), "\r\033[K%s%.*s%s", abs_fore.blue, len, line, abs_fore.normal);
+    _jobs_write(out, olen);
+    p->shown = true;
+}
+
+// what the user sees of a job that finished
+static void _jobs_report(const job_list *jl, _jobs_progress *p, const abs_job *j, int parallel, size_t first){
+    if (jl->quiet) return;
+    bool ok = j->state == JOB_OK;
+    char header[PATH_MAX + 128];
+    switch (jl->output){
+        case JOBS_OUTPUT_PLAIN:
+            if (!_jobs_log_empty(j)) _jobs_flush_log(j, "");
+            break;
+        case JOBS_OUTPUT_LINES:
+            snprintf(header, sizeof(header), "%s[%zu/%zu]%s %s %s (%.1fs)\n",
+                     ok ? abs_fore.green : abs_fore.red, p->done, jl->n, abs_fore.normal,
+                     ok ? jobs_kind_name(j->kind) : "FAILED", j->label, jobs_elapsed_ms(j) / 1000.0);
+            _jobs_flush_log(j, header);
+            break;
+        case JOBS_OUTPUT_STATUS:
+            // quiet successes only move the status line
+            if (!ok || !_jobs_log_empty(j)){
+                _jobs_status_clear(p);
+                snprintf(header, sizeof(header), "%s[%s]%s %s\n", ok ? abs_fore.green : abs_fore.red,
+                         ok ? jobs_kind_name(j->kind) : "FAIL", abs_fore.normal, j->label);
+                _jobs_flush_log(j, header);
+            }
+            _jobs_status(jl, p, parallel, first, true);
+            break;
+    }
+}
+
+/*
+ * Waits for one of this list's running jobs. Each child is watched
+ * through a pidfd so a list never reaps children it did not start, which
+ * keeps concurrent lists in one process (e.g. libabs users) apart. Without
+ * pidfds only this list's pids are reaped: waitid(WNOWAIT) sleeps until
+ * some child exits without reaping it, and a child of the host process
+ * that stays unreaped turns that into polling every 10ms.
+ */
+static abs_job *_jobs_wait(job_list *jl, int running, size_t first){
+    struct pollfd fds[running];
+    size_t idx[running];
+    int n = 0;
+    bool pidfds = true;
+
+    for (size_t i = first; i < jl->n && n < running; i++){
+        if (jl->jobs[i].state != JOB_RUNNING) continue;
+        if (jl->jobs[i].pidfd < 0) pidfds = false;
+        fds[n].fd = jl->jobs[i].pidfd;
+        fds[n].events = POLLIN;
+        idx[n++] = i;
+    }
+
+    while (!pidfds){
+        bool ours = false;
+        for (int k = 0; k < n; k++){
+            abs_job *j = &jl->jobs[idx[k]];
+            pid_t pid = wait4(j->pid, &j->status, WNOHANG, &j->usage);
+            if (pid == j->pid) return j;
+            if (pid < 0 && errno != EINTR) return NULL;
+        }
+
+        siginfo_t info;
+        memset(&info, 0, sizeof(info));
+        if (waitid(P_ALL, 0, &info, WEXITED | WNOWAIT) < 0 && errno != EINTR) return NULL;
+        for (int k = 0; k < n && !ours; k++) ours = info.si_pid == jl->jobs[idx[k]].pid;
+        if (!ours && info.si_pid){
+            struct timespec pause = { 0, 10 * 1000 * 1000 };
+            nanosleep(&pause, NULL);
+        }
+    }
+
+    while (poll(fds, n, -1) < 0){
+        if (errno != EINTR) return NULL;
+    }
+    for (int k = 0; k < n; k++){
+        if (!(fds[k].revents & (POLLIN | POLLHUP))) continue;
+        abs_job *j = &jl->jobs[idx[k]];
+        while (wait4(j->pid, &j->status, 0, &j->usage) < 0 && errno == EINTR);
+        close(j->pidfd);
+        j->pidfd = -1;
+        return j;
+    }
+    return NULL;
+}
+
+/*
+ * Runs every job, at most `max_parallel` at a time. Without `keep_going`
+ * the first failure stops new jobs from starting. Output is captured per
+ * job into its log file and written in one piece once the job finishes,
+ * so nothing interleaves. Returns the number of failed jobs.
+ */
+int jobs_run(job_list *jl, int max_parallel, bool keep_going){
+    if (max_parallel < 1) max_parallel = 1;
+
+    int running = 0, failed = 0;
+    bool stop = false;
+    size_t first = 0;   // every job before it is finished
+    _jobs_progress progress;
+    _jobs_progress_init(jl, &progress);
+    bool status = jl->output == JOBS_OUTPUT_STATUS && !jl->quiet;
+
+    for (;;){
+        while (first < jl->n && _jobs_finished(&jl->jobs[first])) first++;
+        for (size_t i = first; i < jl->n && running < max_parallel; i++){
+            abs_job *j = &jl->jobs[i];
+            if (j->state != JOB_PENDING) continue;
+
+            int ready = stop ? -1 : _jobs_ready(jl, j);
+            if (ready < 0){
+                j->state = JOB_SKIPPED;
+                _jobs_progress_done(&progress, j);
+                // its dependents come later in the list, this pass reaches them
+                _jobs_event(jl, i);
+                continue;
+            }
+            if (ready == 0) continue;
+
+            if (_jobs_cut_off(jl, j)){
+                j->state = JOB_OK;
+                j->unchanged = true;
+                _jobs_progress_done(&progress, j);
+                if (!jl->quiet && !status)
+                    printf("%s[cutoff]%s %s (inputs unchanged)\n", abs_fore.cyan, abs_fore.normal, j->label);
+                _jobs_event(jl, i);
+                continue;
+            }
+
+            if (j->output) j->output_mtime = _jobs_mtime(j->output);
+            j->pid = _jobs_spawn(jl, j, true);
+            if (j->pid < 0){
+                j->state = JOB_FAILED;
+                failed++;
+                _jobs_progress_done(&progress, j);
+                _jobs_event(jl, i);
+                continue;
+            }
+            clock_gettime(CLOCK_MONOTONIC, &j->started);
+            j->pidfd = (int)syscall(SYS_pidfd_open, j->pid, 0);
+            j->state = JOB_RUNNING;
+            running++;
+            _jobs_event(jl, i);
+        }
+
+        if (running == 0) break;
+        if (status) _jobs_status(jl, &progress, max_parallel, first, false);
+
+        abs_job *j = _jobs_wait(jl, running, first);
+        if (!j) break;
+
+        running--;
+        clock_gettime(CLOCK_MONOTONIC, &j->finished);
+        int ok = WIFEXITED(j->status) && WEXITSTATUS(j->status) == 0;
+        j->state = ok ? JOB_OK : JOB_FAILED;
+        if (ok && j->output){
+            struct timespec now = _jobs_mtime(j->output);
+            j->unchanged = now.tv_sec != 0 && now.tv_sec == j->output_mtime.tv_sec &&
+                           now.tv_nsec == j->output_mtime.tv_nsec;
+        }
+
+        _jobs_progress_done(&progress, j);
+        _jobs_report(jl, &progress, j, max_parallel, first);
+        if (!ok){
+            failed++;
+            if (j->invalidate) unlink(j->invalidate);
+            if (!keep_going) stop = true;
+        }
+        _jobs_event(jl, j - jl->jobs);
+    }
+
+    _jobs_status_clear(&progress);
+    return failed;
+}
+
+// grouped report of failed and skipped jobs with their captured diagnostics
+void jobs_summary(const job_list *jl){
+    size_t failed = 0, skipped = 0;
+    for (size_t i = 0; i < jl->n; i++){
+        if (jl->jobs[i].state == JOB_FAILED) failed++;
+        if (jl->jobs[i].state == JOB_SKIPPED) skipped++;
+    }
+    if (!failed && !skipped) return;
+
+    printf("\n%s[summary]%s %zu of %zu jobs failed, %zu skipped\n",
+           abs_fore.red, abs_fore.normal, failed, jl->n, skipped);
+
+    for (size_t i = 0; i < jl->n; i++){
+        const abs_job *j = &jl->jobs[i];
+        if (j->state != JOB_FAILED) continue;
+        printf("%s[FAIL]%s %s\n", abs_fore.red, abs_fore.normal, j->label);
+        _jobs_print_log(j, "    ");
+    }
+    for (size_t i = 0; i < jl->n; i++){
+        const abs_job *j = &jl->jobs[i];
+        if (j->state != JOB_SKIPPED) continue;
+        printf("%s[skip]%s %s (dependency failed)\n", abs_fore.yellow, abs_fore.normal, j->label);
+    }
+}
+
+/*
+ * Durations of earlier runs, for the ETA. One line per job that
+ * succeeded, `ms <TAB> label`, looked up by label since job indices
+ * change between runs.
+ */
+typedef struct {
+    char *label;
+    long  ms;
+} _jobs_record;
+
+static int _jobs_by_label(const void *a, const void *b){
+    return strcmp(((const _jobs_record *)a)->label, ((const _jobs_record *)b)->label);
+}
+
+// sorted by label; `*buf` holds the strings
+static _jobs_record *_jobs_history_read(const char *path, size_t *n, char **buf){
+    *n = 0;
+    *buf = NULL;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return NULL;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !(*buf = malloc(st.st_size + 1))){
+        close(fd);
+        return NULL;
+    }
+    ssize_t len = read(fd, *buf, st.st_size);
+    close(fd);
+    if (len < 0) len = 0;
+    (*buf)[len] = '\0';
+
+    _jobs_record *recs = NULL;
+    for (char *line = *buf, *next; line && *line; line = next){
+        next = strchr(line, '\n');
+        if (next) *next++ = '\0';
+        char *tab = strchr(line, '\t');
+        if (!tab || abs_grow(&recs, *n, sizeof(_jobs_record)) != 0) continue;
+        recs[*n].ms = strtol(line, NULL, 10);
+        recs[(*n)++].label = tab + 1;
+    }
+    if (recs) qsort(recs, *n, sizeof(_jobs_record), _jobs_by_label);
+    return recs;
+}
+
+static _jobs_record *_jobs_history_find(_jobs_record *recs, size_t n, const char *label){
+    _jobs_record key = { (char *)label, 0 };
+    return recs ? bsearch(&key, recs, n, sizeof(_jobs_record), _jobs_by_label) : NULL;
+}
+
+// sets each job's estimate_ms from the history at `path`
+void jobs_history_load(job_list *jl, const char *path){
+    size_t n;
+    char *buf;
+    _jobs_record *recs = _jobs_history_read(path, &n, &buf);
+    for (size_t i = 0; recs && i < jl->n; i++){
+        _jobs_record *r = jl->jobs[i].label ? _jobs_history_find(recs, n, jl->jobs[i].label) : NULL;
+        if (r) jl->jobs[i].estimate_ms = r->ms;
+    }
+    free(recs);
+    free(buf);
+}
+
+// records the jobs that ran and succeeded, keeping every other entry
+void jobs_history_save(const job_list *jl, const char *path){
+    size_t n;
+    char *buf;
+    _jobs_record *recs = _jobs_history_read(path, &n, &buf);
+    size_t old_n = n;
+    bool changed = false;
+    for (size_t i = 0; i < jl->n; i++){
+        const abs_job *j = &jl->jobs[i];
+        if (j->state != JOB_OK || !j->started.tv_sec || !j->label) continue;
+        _jobs_record *r = _jobs_history_find(recs, old_n, j->label);
+        if (!r){
+            if (abs_grow(&recs, n, sizeof(_jobs_record)) != 0) break;
+            r = &recs[n++];
+            r->label = j->label;
+        }
+        r->ms = jobs_elapsed_ms(j);
+        changed = true;
+    }
+
+    char tmp[PATH_MAX + 8];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE *f = changed ? fopen(tmp, "w") : NULL;
+    if (f){
+        for (size_t i = 0; i < n; i++) fprintf(f, "%ld\t%s\n", recs[i].ms, recs[i].label);
+        if (fclose(f) == 0) rename(tmp, path);
+        else unlink(tmp);
+    }
+    free(recs);
+    free(buf);
+}
+
+void jobs_free(job_list *jl){
+    for (size_t i = 0; i < jl->n; i++){
+        free(jl->jobs[i].label);
+        free(jl->jobs[i].cmd);
+        free(jl->jobs[i].log_path);
+        free(jl->jobs[i].invalidate);
+        free(jl->jobs[i].deps);
+        free(jl->jobs[i].output);
+        if (jl->jobs[i].pidfd >= 0) close(jl->jobs[i].pidfd);
+    }
+    free(jl->jobs);
+    for (size_t i = 0; i < jl->env_n; i++) free(jl->env[i]);
+    free(jl->env);
+    memset(jl, 0, sizeof(*jl));
+}
+
+#endif
+#define ABS_JOBS
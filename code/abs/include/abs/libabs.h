@@ -0,0 +1,110 @@
+#include <stddef.h>
+
+#ifndef ABS_LIBABS
+
+/*
+ * libabs - drive abs builds in-process.
+ *
+ * A context owns one loaded configuration. Contexts never exit the
+ * process and never touch global state, so several may be used at once
+ * as long as each one stays on a single thread at a time. Paths inside
+ * the configuration resolve against the working directory at abs_open()
+ * time, like the command line tool.
+ *
+ *     char err[256];
+ *     abs_ctx *ctx = abs_open("abs.conf", err, sizeof(err));
+ *     abs_result res;
+ *     abs_build(ctx, NULL, on_progress, NULL, &res);
+ *     abs_result_free(&res);
+ *     abs_close(ctx);
+ *
+ * Build steps are still announced on stdout ([compile], [skip], ...);
+ * compiler output is captured into abs_job_info.output instead.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ABS_API __attribute__((visibility("default")))
+
+typedef struct abs_ctx abs_ctx;
+
+typedef enum {
+    ABS_JOB_COMPILE,
+    ABS_JOB_LINK,
+    ABS_JOB_GENERATE,   // a [generate.*] rule
+} abs_job_kind;
+
+typedef enum {
+    ABS_JOB_PENDING,
+    ABS_JOB_RUNNING,
+    ABS_JOB_OK,
+    ABS_JOB_FAILED,
+    ABS_JOB_SKIPPED,
+} abs_job_state;
+
+typedef struct {
+    const char *name;              // [project] name, may be NULL
+    const char *version;
+    const char *output;            // binary or library path, NULL without [files]
+    const char *build_type;        // "binary", "static" or "shared"
+    const char *const *sources;
+    size_t sources_n;
+    const char *const *modules;    // [modules] names, built by the abs executable
+    size_t modules_n;
+} abs_target_info;
+
+typedef struct {
+    abs_job_kind  kind;
+    abs_job_state state;
+    const char   *label;           // source or output name
+    const char   *command;
+    const char   *output;          // captured compiler output, NULL until finished
+    int           exit_status;     // -1 unless the job ran
+} abs_job_info;
+
+typedef struct {
+    abs_job_info *jobs;
+    size_t jobs_n;
+    size_t failed;
+    size_t skipped;
+    size_t modules_failed;
+} abs_result;
+
+typedef struct {
+    int force;                     // rebuild everything, like -r
+    int keep_going;                // like -k
+    int jobs;                      // parallel jobs, 0 for the config's default
+    const char *abs_path;          // executable used to build [modules], default "abs";
+                                   // restat and remote compiles need it set
+} abs_build_options;
+
+// called whenever a job starts, finishes or is skipped
+typedef void (*abs_progress_fn)(const abs_job_info *job, size_t finished, size_t total, void *user);
+
+// returns NULL and fills `err` when the configuration cannot be loaded
+ABS_API abs_ctx *abs_open(const char *confpath, char *err, size_t err_sz);
+ABS_API void abs_close(abs_ctx *ctx);
+
+// re-reads the configuration and re-expands source globs
+ABS_API int abs_reload(abs_ctx *ctx);
+ABS_API const char *abs_error(const abs_ctx *ctx);
+
+ABS_API const abs_target_info *abs_target(const abs_ctx *ctx);
+
+// the out-of-date set: jobs a build would run, without running them
+ABS_API int abs_plan(abs_ctx *ctx, const abs_build_options *opts, abs_result *out);
+
+// builds modules and the target; returns 0 when everything succeeded
+ABS_API int abs_build(abs_ctx *ctx, const abs_build_options *opts,
+                      abs_progress_fn progress, void *user, abs_result *out);
+
+ABS_API void abs_result_free(abs_result *res);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+#define ABS_LIBABS
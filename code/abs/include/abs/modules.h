@@ -0,0 +1,366 @@
+#include "configuration.h"
+#include <ctype.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifndef ABS_MODULES
+
+/*
+ * C++20 modules support. Every C++ source is scanned for its module
+ * declaration (what it provides) and its imports (what it requires), the
+ * same information a P1689 scanner reports. Sources are then compiled in
+ * dependency order so a BMI always exists before its first importer.
+ */
+
+typedef struct {
+    char  *provides;     // module exported by this unit, NULL if none
+    char **requires;
+    size_t requires_n;
+    bool   interface;    // `export module ...`
+} module_info;
+
+static const char *module_extensions[] = {
+    ".cpp", ".cxx", ".cc", ".C", ".CPP", ".cppm", ".ixx", NULL
+};
+
+static int is_cxx_source(const char *path){
+    size_t len = strlen(path);
+    for (int i = 0; module_extensions[i] != NULL; i++){
+        size_t ext_len = strlen(module_extensions[i]);
+        if (len > ext_len && strcmp(path + len - ext_len, module_extensions[i]) == 0)
+            return 1;
+    }
+    return 0;
+}
+
+// .cppm/.ixx are not recognized by every driver and need an explicit language
+static int is_module_interface_ext(const char *path){
+    size_t len = strlen(path);
+    return (len > 5 && strcmp(path + len - 5, ".cppm") == 0) ||
+           (len > 4 && strcmp(path + len - 4, ".ixx") == 0);
+}
+
+static int is_clang(const compiler_conf *cfg){
+    return cfg->compiler && strstr(cfg->compiler, "clang") != NULL;
+}
+
+static bool source_ident(char c){
+    return isalnum((unsigned char)c) || c == '_';
+}
+
+// start of the identifier or number token that ends right before `p`
+static const char *_source_token(const char *src, const char *p){
+    while (p > src && source_ident(p[-1])) p--;
+    return p;
+}
+
+static bool _source_in_number(const char *src, const char *p){
+    const char *t = _source_token(src, p);
+    return t < p && isdigit((unsigned char)*t);
+}
+
+/*
+ * `p` is the opening quote of a raw string literal (R"delim(...)delim");
+ * returns its closing quote, or the terminating NUL of an unterminated one,
+ * or NULL when `p` does not open a raw string after all.
+ */
+static char *_source_raw_string(const char *src, char *p, bool strings){
+    const char *t = _source_token(src, p);
+    size_t plen = p - t;
+    if (!plen || p[-1] != 'R' || (plen > 1 && !(plen == 3 && memcmp(t, "u8", 2) == 0) &&
+                                  !(plen == 2 && strchr("LuU", t[0])))) return NULL;
+
+    char *open = p + 1;
+    while (*open && *open != '(' && open - p <= 16 && !isspace((unsigned char)*open) && *open != '"') open++;
+    if (*open != '(') return NULL;
+    size_t dlen = open - (p + 1);
+
+    char *q = open + 1;
+    while (*q && !(*q == ')' && strncmp(q + 1, p + 1, dlen) == 0 && q[1 + dlen] == '"')){
+        if (strings && *q != '\n') *q = ' ';
+        q++;
+    }
+    return *q ? q + 1 + dlen : q;
+}
+
+/*
+ * Comments become spaces, newlines stay so line based scans still find
+ * preprocessor lines. With `strings`, so do the contents of string and
+ * character literals, raw ones included; their quotes stay. A quote
+ * inside a number (1'000) is a digit separator.
+ */
+static void source_blank_comments(char *src, bool strings){
+    char quote = 0;
+    for (char *p = src; *p; p++){
+        char *raw;
+        if (quote){
+            if (*p == '\\' && p[1]){
+                if (strings) *p = ' ';
+                p++;
+                if (strings && *p != '\n') *p = ' ';
+            } else if (*p == quote) quote = 0;
+            else if (strings && *p != '\n') *p = ' ';
+        } else if (*p == '"' && (raw = _source_raw_string(src, p, strings))){
+            p = raw;
+            if (!*p) break;
+        } else if (*p == '\'' && _source_in_number(src, p)){
+            continue;
+        } else if (*p == '"' || *p == '\''){
+            quote = *p;
+        } else if (p[0] == '/' && p[1] == '/'){
+            while (*p && *p != '\n') *p++ = ' ';
+            if (!*p) break;
+        } else if (p[0] == '/' && p[1] == '*'){
+            *p++ = ' ';
+            *p = ' ';
+            while (p[1] && !(p[1] == '*' && p[2] == '/')){
+                p++;
+                if (*p != '\n') *p = ' ';
+            }
+            if (!p[1]) break;
+            p[1] = p[2] = ' ';
+            p += 2;
+        }
+    }
+}
+
+static void _module_require(module_info *info, const char *name){
+    for (size_t i = 0; i < info->requires_n; i++){
+        if (strcmp(info->requires[i], name) == 0) return;
+    }
+    char **tmp = realloc(info->requires, sizeof(char*) * (info->requires_n + 1));
+    if (!tmp) return;
+    info->requires = tmp;
+    info->requires[info->requires_n++] = strdup(name);
+}
+
+static const char *_module_word(const char *p, const char *end, const char *word){
+    size_t len = strlen(word);
+    if ((size_t)(end - p) <= len || memcmp(p, word, len) != 0) return NULL;
+    if (isalnum((unsigned char)p[len]) || p[len] == '_') return NULL;
+    p += len;
+    while (p < end && (*p == ' ' || *p == '\t')) p++;
+    return p;
+}
+
+static size_t _module_name_len(const char *p, const char *end){
+    const char *s = p;
+    while (s < end && (isalnum((unsigned char)*s) || *s == '_' || *s == '.' || *s == ':')) s++;
+    return s - p;
+}
+
+int modules_scan(const char *path, module_info *info){
+    memset(info, 0, sizeof(*info));
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0){
+        close(fd);
+        return 0;
+    }
+
+    // a private copy, comments and literals blanked so neither hides nor fakes an import
+    char *data = malloc(st.st_size + 1);
+    ssize_t got = 0;
+    while (data && got < st.st_size){
+        ssize_t r = read(fd, data + got, st.st_size - got);
+        if (r <= 0) break;
+        got += r;
+    }
+    close(fd);
+    if (!data || got < st.st_size){
+        free(data);
+        return -1;
+    }
+    data[got] = '\0';
+    source_blank_comments(data, true);
+
+    const char *end = data + got;
+    char current[256] = {0};
+
+    for (const char *line = data; line < end; ){
+        const char *nl = memchr(line, '\n', end - line);
+        const char *eol = nl ? nl : end;
+        const char *p = line;
+        line = nl ? nl + 1 : end;
+
+        while (p < eol && (*p == ' ' || *p == '\t')) p++;
+
+        int exported = 0;
+        const char *q = _module_word(p, eol, "export");
+        if (q){
+            exported = 1;
+            p = q;
+        }
+
+        if ((q = _module_word(p, eol, "module"))){
+            size_t len = _module_name_len(q, eol);
+            // `module;` and `module :private;` open fragments, not units
+            if (len == 0 || q[0] == ':') continue;
+
+            snprintf(current, sizeof(current), "%.*s", (int)len, q);
+            if (exported){
+                info->provides = strdup(current);
+                info->interface = true;
+            } else if (strchr(current, ':')){
+                // partition implementation unit
+                info->provides = strdup(current);
+            } else {
+                // implementation unit implicitly imports its interface
+                _module_require(info, current);
+            }
+            continue;
+        }
+
+        if ((q = _module_word(p, eol, "import"))){
+            // header units (`import <x>;`) are left to the compiler
+            if (*q == '<' || *q == '"') continue;
+
+            size_t len = _module_name_len(q, eol);
+            if (len == 0) continue;
+
+            char name[512];
+            if (q[0] == ':'){
+                char primary[256];
+                snprintf(primary, sizeof(primary), "%s", current);
+                char *colon = strchr(primary, ':');
+                if (colon) *colon = '\0';
+                snprintf(name, sizeof(name), "%s%.*s", primary, (int)len, q);
+            } else {
+                snprintf(name, sizeof(name), "%.*s", (int)len, q);
+            }
+            _module_require(info, name);
+        }
+    }
+
+    free(data);
+    return 0;
+}
+
+void module_info_free(module_info *info){
+    if (!info) return;
+    free(info->provides);
+    for (size_t i = 0; i < info->requires_n; i++) free(info->requires[i]);
+    free(info->requires);
+    memset(info, 0, sizeof(*info));
+}
+
+// index of the unit providing `name`, or -1 for modules built elsewhere
+static long modules_provider(const module_info *infos, size_t n, const char *name){
+    for (size_t i = 0; i < n; i++){
+        if (infos[i].provides && strcmp(infos[i].provides, name) == 0) return (long)i;
+    }
+    return -1;
+}
+
+/*
+ * Fills `order` with source indices such that every provider comes before
+ * its importers; the original order is kept otherwise. Returns -1 on cycle.
+ */
+int modules_order(const module_info *infos, size_t n, size_t *order){
+    char *state = calloc(n, 1); // 0 - new, 1 - visiting, 2 - done
+    size_t *stack = malloc(sizeof(size_t) * (n ? n : 1));
+    size_t *edge = malloc(sizeof(size_t) * (n ? n : 1));
+    if (!state || !stack || !edge){
+        free(state); free(stack); free(edge);
+        return -1;
+    }
+
+    size_t done = 0;
+    int ret = 0;
+
+    for (size_t root = 0; root < n && ret == 0; root++){
+        if (state[root]) continue;
+
+        size_t sp = 0;
+        stack[sp] = root;
+        edge[sp++] = 0;
+        state[root] = 1;
+
+        while (sp > 0){
+            size_t cur = stack[sp - 1];
+            if (edge[sp - 1] < infos[cur].requires_n){
+                long dep = modules_provider(infos, n, infos[cur].requires[edge[sp - 1]++]);
+                if (dep < 0 || (size_t)dep == cur) continue;
+                if (state[dep] == 1){
+                    fprintf(stderr, "%s[error]%s module import cycle through %s\n",
+                            abs_fore.red, abs_fore.normal, infos[dep].provides);
+                    ret = -1;
+                    break;
+                }
+                if (state[dep] == 0){
+                    state[dep] = 1;
+                    stack[sp] = dep;
+                    edge[sp++] = 0;
+                }
+                continue;
+            }
+
+            state[cur] = 2;
+            order[done++] = cur;
+            sp--;
+        }
+    }
+
+    free(state);
+    free(stack);
+    free(edge);
+    return ret;
+}
+
+static void module_bmi_path(const compiler_conf *cfg, const char *name, char *out, size_t out_sz){
+    snprintf(out, out_sz, "%s/%s.%s", cfg->obj_dir, name, is_clang(cfg) ? "pcm" : "gcm");
+    // partitions are `M:P`; clang's prebuilt path lookup expects `M-P.pcm`
+    for (char *p = out + strlen(cfg->obj_dir) + 1; *p; p++){
+        if (*p == ':') *p = '-';
+    }
+}
+
+/*
+ * gcc resolves BMIs through a mapper file, written once per build into the
+ * objects directory and listing every module provided by this config.
+ */
+int modules_write_mapper(const compiler_conf *cfg, const module_info *infos, size_t n){
+    if (is_clang(cfg)) return 0;
+
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/modules.map", cfg->obj_dir);
+
+    FILE *f = fopen(path, "w");
+    if (!f) return -1;
+    for (size_t i = 0; i < n; i++){
+        if (!infos[i].provides) continue;
+        char bmi[PATH_MAX];
+        module_bmi_path(cfg, infos[i].provides, bmi, sizeof(bmi));
+        fprintf(f, "%s %s\n", infos[i].provides, bmi);
+    }
+    fclose(f);
+    return 0;
+}
+
+static size_t build_module_flags(const compiler_conf *cfg, const module_info *info,
+                                 const char *src, char *out_buf, size_t out_sz, size_t pos){
+    if (is_clang(cfg)){
+        pos += snprintf(out_buf + pos, out_sz - pos, "-fprebuilt-module-path=\"%s\" ", cfg->obj_dir);
+        if (info->provides){
+            char bmi[PATH_MAX];
+            module_bmi_path(cfg, info->provides, bmi, sizeof(bmi));
+            pos += snprintf(out_buf + pos, out_sz - pos, "-fmodule-output=\"%s\" ", bmi);
+        }
+        if (is_module_interface_ext(src))
+            pos += snprintf(out_buf + pos, out_sz - pos, "-x c++-module ");
+    } else {
+        pos += snprintf(out_buf + pos, out_sz - pos,
+                        "-fmodules-ts -fmodule-mapper=\"%s/modules.map\" ", cfg->obj_dir);
+        if (is_module_interface_ext(src))
+            pos += snprintf(out_buf + pos, out_sz - pos, "-x c++ ");
+    }
+    return pos;
+}
+
+#endif
+#define ABS_MODULES
@@ -0,0 +1,585 @@
+#include "compilation.h"
+#include "arena.h"
+
+#ifndef ABS_NINJA
+
+/*
+ * `abs --emit-ninja`. The root configuration and every [modules] entry,
+ * recursively, are resolved as abs would build them and written as one
+ * build.ninja in the working directory:
+ *   - compiles get `deps = gcc` depfiles, links share `link_pool`
+ *   - a link depends on every library of [dependencies] libs that a module
+ *     of the tree produces, found through [dirs] libs like the linker does
+ *   - build.ninja depends on every abs.conf (and [shared] headers, which
+ *     version scripts are made from) and is regenerated when they change
+ * A module is resolved from its own directory, so paths are absolute and
+ * commands start with `cd` into it, as its abs build would run.
+ */
+
+typedef struct {
+    FILE       *f;
+    abs_arena   arena;
+    abs_strtab  names;      // interned paths; a configuration found here was already written
+    const char **outputs;   // every config output, for `all` and library edges
+    size_t      outputs_n;
+    const char **inputs;    // files build.ninja is generated from
+    size_t      inputs_n;
+    size_t      configs;    // configurations written, inputs also hold [shared] headers
+    size_t      edges;
+} ninja_writer;
+
+static const char *_ninja_keep(ninja_writer *w, const char *s){
+    return strtab_intern(&w->names, s, strlen(s));
+}
+
+static void _ninja_push(ninja_writer *w, const char ***arr, size_t *n, const char *s){
+    const char *kept = _ninja_keep(w, s);
+    if (!kept || abs_grow(arr, *n, sizeof(char*)) != 0) return;
+    (*arr)[(*n)++] = kept;
+}
+
+// `$`, spaces and colons are special in ninja paths, only `$` in variable values
+static void _ninja_escape(FILE *f, const char *s, bool path){
+    for (; *s; s++){
+        if (*s == '$' || (path && (*s == ' ' || *s == ':'))) fputc('$', f);
+        fputc(*s, f);
+    }
+}
+
+// drops `.` and folds `..` in an absolute path, so `app/../lib` and `lib` are one ninja node
+static void _ninja_normalize(char *path){
+    char *out = path;
+    for (const char *p = path; *p;){
+        while (*p == '/') p++;
+        const char *end = strchrnul(p, '/');
+        size_t len = end - p;
+        if (len == 0 || (len == 1 && p[0] == '.')) {
+            // nothing
+        } else if (len == 2 && p[0] == '.' && p[1] == '.') {
+            while (out > path && *--out != '/');
+        } else {
+            *out++ = '/';
+            memmove(out, p, len);
+            out += len;
+        }
+        p = end;
+    }
+    if (out == path) *out++ = '/';
+    *out = '\0';
+}
+
+// `path` from `dir`, normalized
+static char *_ninja_join(const char *dir, const char *path){
+    if (!path) return NULL;
+    size_t len = strlen(dir) + strlen(path) + 2;
+    char *out = malloc(len);
+    if (!out) return NULL;
+    if (path[0] == '/') snprintf(out, len, "%s", path);
+    else snprintf(out, len, "%s/%s", dir, path);
+    _ninja_normalize(out);
+    return out;
+}
+
+static void _ninja_absolute(const char *dir, char **path){
+    char *full = _ninja_join(dir, *path);
+    if (!full) return;
+    free(*path);
+    *path = full;
+}
+
+// commands run from the build.ninja directory; the config's own build ran from `dir`
+static void _ninja_make_absolute(compiler_conf *cfg, const char *dir){
+    _ninja_absolute(dir, &cfg->src_dir);
+    _ninja_absolute(dir, &cfg->out_dir);
+    _ninja_absolute(dir, &cfg->obj_dir);
+    for (size_t i = 0; i < cfg->include_n; i++) _ninja_absolute(dir, &cfg->include_dirs[i]);
+    for (size_t i = 0; i < cfg->lib_dirs_n; i++) _ninja_absolute(dir, &cfg->lib_dirs[i]);
+    for (size_t i = 0; i < cfg->ldlibs_n; i++){
+        if (strchr(cfg->ldlibs[i], '/')) _ninja_absolute(dir, &cfg->ldlibs[i]);
+    }
+    for (size_t r = 0; r < cfg->generators_n; r++){
+        gen_rule *rule = &cfg->generators[r];
+        for (size_t i = 0; i < rule->inputs_n; i++) _ninja_absolute(dir, &rule->inputs[i]);
+        for (size_t i = 0; i < rule->outputs_n; i++) _ninja_absolute(dir, &rule->outputs[i]);
+    }
+}
+
+static void _ninja_rules(FILE *f, int link_pool){
+    fprintf(f,
+        "# generated by abs --emit-ninja, edit abs.conf instead\n"
+        "ninja_required_version = 1.7\n\n"
+        "pool link_pool\n"
+        "  depth = %d\n\n"
+        "rule cc\n"
+        "  command = $cmd\n"
+        "  depfile = $out.d\n"
+        "  deps = gcc\n"
+        "  restat = 1\n"
+        "  description = CC $desc\n\n"
+        "rule link\n"
+        "  command = $cmd\n"
+        "  rspfile = $rspfile\n"
+        "  rspfile_content = $in\n"
+        "  pool = link_pool\n"
+        "  restat = 1\n"
+        "  description = LINK $desc\n\n"
+        "rule generate\n"
+        "  command = $cmd\n"
+        "  restat = 1\n"
+        "  description = GEN $desc\n\n"
+        "rule regen\n"
+        "  command = $cmd\n"
+        "  generator = 1\n"
+        "  description = Regenerating build.ninja\n\n",
+        link_pool > 0 ? link_pool : 1);
+}
+
+// what a config's jobs get from abs: its directory and environment
+static size_t _ninja_prefix(const compiler_conf *cfg, const char *dir, char *out, size_t out_sz){
+    size_t pos = snprintf(out, out_sz, "cd \"%s\" && ", dir);
+    const char *main_dir = getenv("MAIN_DIR");
+    const char *epoch = getenv("SOURCE_DATE_EPOCH");
+    if (main_dir) pos += snprintf(out + pos, out_sz - pos, "export MAIN_DIR=\"%s\" && ", main_dir);
+    if (cfg->pkg_config_path)
+        pos += snprintf(out + pos, out_sz - pos, "export PKG_CONFIG_PATH=\"%s\" && ", cfg->pkg_config_path);
+    if (cfg->reproducible)
+        pos += snprintf(out + pos, out_sz - pos, "export SOURCE_DATE_EPOCH=%s && ", epoch && *epoch ? epoch : "0");
+    return pos;
+}
+
+/*
+ * One object. `bmi` is written next to it (a module interface), `needs`
+ * are BMIs it imports and `headers` generated headers it may include.
+ */
+static void _ninja_compile(ninja_writer *w, const compiler_conf *cfg, const char *prefix,
+                           const char *label, const char *src, const char *src_full_path,
+                           const char *obj_path, const char *extra, const char *bmi,
+                           const char **needs, size_t needs_n, const char **headers, size_t headers_n){
+    char cmd[8192], tagged[PATH_MAX + 160], self[PATH_MAX];
+    int restat = cfg->restat && !is_split_debug(cfg) && abs_self(cfg, self, sizeof(self)) == 0;
+    size_t pos = snprintf(cmd, sizeof(cmd), "%s%s ", prefix, cfg->compiler);
+
+    if (cfg->build_type && strcmp(cfg->build_type, "shared") == 0) {
+        pos += snprintf(cmd + pos, sizeof(cmd) - pos, "-fPIC ");
+    }
+    pos = build_shared_cflags(cfg, cmd, sizeof(cmd), pos);
+    pos = build_common_flags(cfg, cmd, sizeof(cmd), pos);
+    pos = build_source_flags(cfg, src, cmd, sizeof(cmd), pos);
+    pos = build_debuginfo_flags(cfg, cmd, sizeof(cmd), pos);
+    if (cfg->reproducible) {
+        pos += snprintf(cmd + pos, sizeof(cmd) - pos, "-frandom-seed=%s ", obj_path);
+    }
+    if (extra && *extra) {
+        pos += snprintf(cmd + pos, sizeof(cmd) - pos, "%s", extra);
+    }
+    // -MT keeps the depfile naming the object when restat compiles to OBJECT.tmp
+    pos += snprintf(cmd + pos, sizeof(cmd) - pos, "-MD -MF \"%s.d\" -MT \"%s\" -c \"%s\" -o \"%s%s\" ",
+                    obj_path, obj_path, src_full_path, obj_path, restat ? ".tmp" : "");
+    if (restat) {
+        snprintf(cmd + pos, sizeof(cmd) - pos, "&& \"%s\" --restat \"%s.tmp\" \"%s\"", self, obj_path, obj_path);
+    }
+
+    fputs("build ", w->f);
+    _ninja_escape(w->f, obj_path, true);
+    if (bmi) {
+        fputs(" | ", w->f);
+        _ninja_escape(w->f, bmi, true);
+    }
+    fputs(": cc ", w->f);
+    _ninja_escape(w->f, src_full_path, true);
+    if (needs_n) fputs(" |", w->f);
+    for (size_t i = 0; i < needs_n; i++){
+        fputc(' ', w->f);
+        _ninja_escape(w->f, needs[i], true);
+    }
+    if (headers_n) fputs(" ||", w->f);
+    for (size_t i = 0; i < headers_n; i++){
+        fputc(' ', w->f);
+        _ninja_escape(w->f, headers[i], true);
+    }
+    fputs("\n  cmd = ", w->f);
+    _ninja_escape(w->f, cmd, false);
+    fputs("\n  desc = ", w->f);
+    _ninja_escape(w->f, job_label(cfg, label, tagged, sizeof(tagged)), false);
+    fputs("\n", w->f);
+    w->edges++;
+}
+
+static void _ninja_generate(ninja_writer *w, const gen_rule *rule, const char *prefix){
+    fputs("build", w->f);
+    for (size_t i = 0; i < rule->outputs_n; i++){
+        fputc(' ', w->f);
+        _ninja_escape(w->f, rule->outputs[i], true);
+    }
+    fputs(": generate", w->f);
+    for (size_t i = 0; i < rule->inputs_n; i++){
+        fputc(' ', w->f);
+        _ninja_escape(w->f, rule->inputs[i], true);
+    }
+    fputs("\n  cmd = ", w->f);
+    _ninja_escape(w->f, prefix, false);
+    fputs("( ", w->f);
+    _ninja_escape(w->f, rule->command, false);
+    fprintf(w->f, " )\n  desc = %s\n", rule->name);
+    w->edges++;
+}
+
+// libraries of [dependencies] libs that another config of the tree builds
+static size_t _ninja_library_deps(ninja_writer *w, const compiler_conf *cfg, const char ***out_libs){
+    static const char *exts[] = { "a", "so", NULL };
+    size_t n = 0;
+    for (size_t l = 0; l < cfg->ldlibs_n; l++){
+        for (size_t o = 0; o < w->outputs_n; o++){
+            const char *out = w->outputs[o];
+            bool match = strcmp(out, cfg->ldlibs[l]) == 0;
+            for (size_t d = 0; !match && d < cfg->lib_dirs_n; d++){
+                for (int e = 0; !match && exts[e]; e++){
+                    char lib[PATH_MAX];
+                    snprintf(lib, sizeof(lib), "%s/lib%s.%s", cfg->lib_dirs[d], cfg->ldlibs[l], exts[e]);
+                    match = strcmp(out, lib) == 0;
+                }
+            }
+            if (match) _ninja_push(w, out_libs, &n, out);
+        }
+    }
+    return n;
+}
+
+static void _ninja_link(ninja_writer *w, const compiler_conf *cfg, const char *prefix,
+                        const build_artifacts *art, const char *has_script){
+    char *cmd = malloc(ABS_CMD_MAX), out_path[PATH_MAX], rsp[PATH_MAX + 16], self[PATH_MAX];
+    size_t sz = ABS_CMD_MAX, pos = 0;
+    if (!cmd) return;
+    get_output_path(cfg, out_path, sizeof(out_path));
+    snprintf(rsp, sizeof(rsp), "%s/link.rsp", cfg->obj_dir);
+
+    bool is_static = strcmp(cfg->build_type, "static") == 0, is_shared = strcmp(cfg->build_type, "shared") == 0;
+    int restat = cfg->restat && !is_static && abs_self(cfg, self, sizeof(self)) == 0;
+    char target[PATH_MAX + 8];
+    snprintf(target, sizeof(target), restat ? "%s.tmp" : "%s", out_path);
+
+    pos += snprintf(cmd + pos, sz - pos, "%s", prefix);
+    if (is_static) {
+        const char *mode = cfg->thin_archive ? (cfg->reproducible ? "rcsTD" : "rcsT")
+                                             : (cfg->reproducible ? "rcsD" : "rcs");
+        pos += snprintf(cmd + pos, sz - pos, "rm -f \"%s\" && ar %s \"%s\" @\"%s\" ", out_path, mode, out_path, rsp);
+    } else {
+        pos += snprintf(cmd + pos, sz - pos, "%s %s", cfg->compiler, is_shared ? "-shared " : "");
+        if (!is_shared) pos = build_common_flags(cfg, cmd, sz, pos);
+        pos = build_link_flags(cfg, cmd, sz, pos);
+        if (is_shared) pos = build_shared_ldflags(cfg, has_script, cmd, sz, pos);
+        pos += snprintf(cmd + pos, sz - pos, "-o \"%s\" @\"%s\" ", target, rsp);
+        pos = build_ldlibs(cfg, cmd, sz, pos);
+        pos = build_restat_cmd(restat ? self : NULL, target, out_path, cmd, sz, pos);
+        pos = build_dwp_cmd(cfg, art, out_path, cmd, sz, pos);
+    }
+
+    fputs("build ", w->f);
+    _ninja_escape(w->f, out_path, true);
+    fputs(": link", w->f);
+    for (size_t i = 0; i < art->obj_n; i++){
+        fputc(' ', w->f);
+        _ninja_escape(w->f, art->obj_paths[i], true);
+    }
+    // a static library relinks nothing, its users pick up the change
+    const char **libs = NULL;
+    size_t libs_n = is_static ? 0 : _ninja_library_deps(w, cfg, &libs);
+    if (libs_n) fputs(" |", w->f);
+    for (size_t i = 0; i < libs_n; i++){
+        fputc(' ', w->f);
+        _ninja_escape(w->f, libs[i], true);
+    }
+    free(libs);
+    char tagged[PATH_MAX + 160];
+    fputs("\n  cmd = ", w->f);
+    _ninja_escape(w->f, cmd, false);
+    fputs("\n  rspfile = ", w->f);
+    _ninja_escape(w->f, rsp, false);
+    fputs("\n  desc = ", w->f);
+    _ninja_escape(w->f, job_label(cfg, cfg->output, tagged, sizeof(tagged)), false);
+    fputs("\n", w->f);
+    w->edges++;
+
+    _ninja_push(w, &w->outputs, &w->outputs_n, out_path);
+    free(cmd);
+}
+
+/*
+ * The edges of one resolved configuration, like build_config_emit_jobs
+ * plans them. [generate.NAME] rules are shared by --modes, so only the
+ * first mode writes their edges (`generators`).
+ */
+static int _ninja_config(ninja_writer *w, const compiler_conf *cfg, const char *dir, bool generators){
+    char prefix[PATH_MAX * 3];
+    _ninja_prefix(cfg, dir, prefix, sizeof(prefix));
+    mkdir_p(cfg->obj_dir);
+
+    const char *phase = cfg->build_phase ? cfg->build_phase : "all";
+    int phase_compile = strcmp(phase, "compile") == 0 || strcmp(phase, "all") == 0;
+    int phase_link = strcmp(phase, "link") == 0 || strcmp(phase, "all") == 0;
+
+    build_artifacts art;
+    _init_artifacts(&art);
+    const char **headers = NULL;
+    size_t headers_n = 0;
+    for (size_t r = 0; phase_compile && r < cfg->generators_n; r++){
+        if (generators) _ninja_generate(w, &cfg->generators[r], prefix);
+        for (size_t o = 0; o < cfg->generators[r].outputs_n; o++){
+            const char *out = cfg->generators[r].outputs[o];
+            if (!is_compiled_source(out)) _ninja_push(w, &headers, &headers_n, out);
+        }
+    }
+
+    size_t n = cfg->sources_n ? cfg->sources_n : 1;
+    module_info *minfo = calloc(n, sizeof(module_info));
+    if (!minfo) {
+        free(headers);
+        _free_artifacts(&art);
+        return -1;
+    }
+    int uses_modules = 0;
+    for (size_t i = 0; i < cfg->sources_n; i++) {
+        char src_full_path[PATH_MAX];
+        snprintf(src_full_path, sizeof(src_full_path), "%s/%s", cfg->src_dir, cfg->sources[i]);
+        if (!is_cxx_source(src_full_path)) continue;
+        modules_scan(src_full_path, &minfo[i]);
+        if (minfo[i].provides || minfo[i].requires_n) uses_modules = 1;
+    }
+    if (phase_compile && uses_modules) modules_write_mapper(cfg, minfo, cfg->sources_n);
+
+    // modules are ordered by their BMIs, so sources keep their listed order
+    for (size_t i = 0; i < cfg->sources_n; i++) {
+        const char *src = cfg->sources[i];
+        if (is_variant_source(cfg, src)) continue;
+        char obj_path[PATH_MAX], src_full_path[PATH_MAX], extra[PATH_MAX * 2] = {0}, bmi[PATH_MAX];
+        get_obj_path(cfg, src, obj_path, sizeof(obj_path));
+        snprintf(src_full_path, sizeof(src_full_path), "%s/%s", cfg->src_dir, src);
+        _add_artifact(&art, src_full_path, obj_path, 1);
+        if (!phase_compile) continue;
+
+        const char **needs = NULL;
+        size_t needs_n = 0;
+        if (uses_modules && is_cxx_source(src_full_path)) {
+            build_module_flags(cfg, &minfo[i], src_full_path, extra, sizeof(extra), 0);
+            if (minfo[i].provides) module_bmi_path(cfg, minfo[i].provides, bmi, sizeof(bmi));
+            for (size_t r = 0; r < minfo[i].requires_n; r++) {
+                char dep[PATH_MAX];
+                if (modules_provider(minfo, cfg->sources_n, minfo[i].requires[r]) < 0) continue;
+                module_bmi_path(cfg, minfo[i].requires[r], dep, sizeof(dep));
+                _ninja_push(w, &needs, &needs_n, dep);
+            }
+        }
+        _ninja_compile(w, cfg, prefix, src, src, src_full_path, obj_path, extra,
+                       uses_modules && minfo[i].provides ? bmi : NULL, needs, needs_n, headers, headers_n);
+        free(needs);
+    }
+
+    if (cfg->variant_sources_n && variants_check_linkage(cfg) != 0) {
+        for (size_t i = 0; i < cfg->sources_n; i++) module_info_free(&minfo[i]);
+        free(minfo);
+        free(headers);
+        _free_artifacts(&art);
+        return -1;
+    }
+    if (cfg->variant_sources_n) {
+        for (size_t i = 0; i < cfg->variant_sources_n; i++) {
+            const char *src = cfg->variant_sources[i];
+            char src_full_path[PATH_MAX];
+            snprintf(src_full_path, sizeof(src_full_path), "%s/%s", cfg->src_dir, src);
+            for (size_t l = 0; l <= cfg->variant_levels_n; l++) {
+                const char *level = l == 0 ? NULL : cfg->variant_levels[l - 1];
+                char suffix[128], obj_path[PATH_MAX], label[PATH_MAX + 128], extra[4096] = {0};
+                variant_suffix(level ? level : "base", suffix, sizeof(suffix));
+                get_variant_obj_path(cfg, src, suffix, obj_path, sizeof(obj_path));
+                snprintf(label, sizeof(label), "%s [%s]", src, level ? level : "base");
+                build_variant_flags(cfg, level, extra, sizeof(extra), 0);
+                _add_artifact(&art, src_full_path, obj_path, 1);
+                if (phase_compile)
+                    _ninja_compile(w, cfg, prefix, label, src, src_full_path, obj_path, extra,
+                                   NULL, NULL, 0, headers, headers_n);
+            }
+        }
+        char disp_src[PATH_MAX], disp_obj[PATH_MAX];
+        snprintf(disp_src, sizeof(disp_src), "%s/abs_dispatch.c", cfg->obj_dir);
+        snprintf(disp_obj, sizeof(disp_obj), "%s/abs_dispatch.o", cfg->obj_dir);
+        _add_artifact(&art, disp_src, disp_obj, 1);
+        compiler_conf disp;
+        if (phase_compile && variants_write_dispatcher(cfg, disp_src) == 0 &&
+            variants_dispatcher_conf(cfg, &disp) == 0) {
+            _ninja_compile(w, &disp, prefix, "[variants] dispatcher", "abs_dispatch.c", disp_src, disp_obj,
+                           "-x c ", NULL, NULL, 0, NULL, 0);
+            free(disp.cflags);
+        }
+    }
+
+    if (phase_link) {
+        char version_script[PATH_MAX + 8];
+        int has_script = shared_write_version_script(cfg, version_script, sizeof(version_script));
+        _ninja_link(w, cfg, prefix, &art, has_script > 0 ? version_script : NULL);
+        for (size_t i = 0; i < cfg->export_headers_n; i++){
+            char *header = _ninja_join(dir, cfg->export_headers[i]);
+            if (header) _ninja_push(w, &w->inputs, &w->inputs_n, header);
+            free(header);
+        }
+    } else {
+        for (size_t i = 0; i < art.obj_n; i++) _ninja_push(w, &w->outputs, &w->outputs_n, art.obj_paths[i]);
+    }
+    fputs("\n", w->f);
+
+    for (size_t i = 0; i < cfg->sources_n; i++) module_info_free(&minfo[i]);
+    free(minfo);
+    free(headers);
+    _free_artifacts(&art);
+    return 0;
+}
+
+/*
+ * Writes the edges of `confpath`, read from `dir`, after those of its
+ * modules, as a child abs would build them: from the module's directory
+ * with $MAIN_DIR set to the parent's configuration directory.
+ */
+static int _ninja_tree(ninja_writer *w, const char *dir, const char *confpath, const char *modes){
+    char saved[PATH_MAX], conf_full[PATH_MAX], config_dir[PATH_MAX];
+    if (!getcwd(saved, sizeof(saved)) || chdir(dir) != 0) {
+        fprintf(stderr, "%s[error]%s cannot enter %s\n", abs_fore.red, abs_fore.normal, dir);
+        return -1;
+    }
+    int r = -1;
+    ini_config conf;
+    if (!realpath(confpath, conf_full) || ini_load_file(&conf, confpath) < 0) {
+        fprintf(stderr, "%sfailed%s to load configuration: %s%s/%s%s\n", abs_fore.red, abs_fore.normal,
+                abs_fore.gray, dir, confpath, abs_fore.normal);
+        chdir(saved);
+        return -1;
+    }
+    if (strtab_find(&w->names, conf_full)) {
+        ini_clear_config(&conf);
+        chdir(saved);
+        return 0;
+    }
+    _ninja_push(w, &w->inputs, &w->inputs_n, conf_full);
+    w->configs++;
+    snprintf(config_dir, sizeof(config_dir), "%s", conf_full);
+    *strrchr(config_dir, '/') = '\0';
+
+    const char *main_dir = getenv("MAIN_DIR");
+    char *parent_main = main_dir ? strdup(main_dir) : NULL;
+    setenv("MAIN_DIR", config_dir, 1);
+    ini_iterator it = ini_iterator_init(&conf);
+    for (ini_iter i = ini_iterate(&it); i.sec_name; i = ini_iterate(&it)){
+        if (strcmp(i.sec_name, "modules") != 0 || !strchr(i.value, ',')) continue;
+        char *module_path = get_before(i.value, ',');
+        char module_dir[PATH_MAX * 2];
+        snprintf(module_dir, sizeof(module_dir), "%s/%s", config_dir, module_path);
+        free(module_path);
+        if (_ninja_tree(w, module_dir, struntilnot(strchr(i.value, ',') + 1, ' '), NULL) != 0) goto _restore;
+    }
+    if (parent_main) setenv("MAIN_DIR", parent_main, 1);
+    else unsetenv("MAIN_DIR");
+
+    r = 0;
+    if (ini_check(&conf, "files") == 0){
+        compiler_conf cconf;
+        memset(&cconf, 0, sizeof(cconf));
+        char cwd[PATH_MAX];
+        if (config_ini_parse(&conf, &cconf) != 0 || !getcwd(cwd, sizeof(cwd))) {
+            r = -1;
+            goto _restore;
+        }
+        config_set_root(&cconf, config_dir);
+        // nothing was built, nothing is cleaned up
+        cconf.cleanup = false;
+        _ninja_make_absolute(&cconf, cwd);
+
+        size_t modes_n = 0;
+        char **mode_list = modes ? _str_split(modes, ',', &modes_n) : NULL;
+        for (size_t m = 0; r == 0 && m < modes_n; m++){
+            compiler_conf mode_conf;
+            r = config_for_mode(&conf, &cconf, mode_list[m], &mode_conf);
+            if (r == 0) r = _ninja_config(w, &mode_conf, cwd, m == 0);
+            mode_conf.cleanup = false;
+            config_mode_free(&mode_conf);
+        }
+        if (!modes) r = _ninja_config(w, &cconf, cwd, true);
+        for (size_t m = 0; m < modes_n; m++) free(mode_list[m]);
+        free(mode_list);
+        compiler_conf_free(&cconf);
+    }
+
+_restore:
+    if (parent_main) setenv("MAIN_DIR", parent_main, 1);
+    else unsetenv("MAIN_DIR");
+    free(parent_main);
+    ini_clear_config(&conf);
+    chdir(saved);
+    return r;
+}
+
+/*
+ * `abs --emit-ninja [--modes A,B] [-j N] [PATH]`: writes build.ninja for
+ * PATH and its modules; -j sets the depth of the link pool.
+ */
+int ninja_emit(const char *confpath, const build_opts *opts){
+    char cwd[PATH_MAX], path[PATH_MAX + 16], tmp[PATH_MAX + 32], self[PATH_MAX];
+    if (!getcwd(cwd, sizeof(cwd))) return -1;
+    snprintf(path, sizeof(path), "%s/build.ninja", cwd);
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+
+    ninja_writer w;
+    memset(&w, 0, sizeof(w));
+    w.names.arena = &w.arena;
+    w.f = fopen(tmp, "w");
+    if (!w.f) {
+        fprintf(stderr, "%s[error]%s cannot write %s\n", abs_fore.red, abs_fore.normal, tmp);
+        return -1;
+    }
+    _ninja_rules(w.f, opts->jobs);
+    int r = _ninja_tree(&w, cwd, confpath, opts->modes);
+
+    if (r == 0) {
+        fputs("build all: phony", w.f);
+        for (size_t i = 0; i < w.outputs_n; i++){
+            fputc(' ', w.f);
+            _ninja_escape(w.f, w.outputs[i], true);
+        }
+        fputs("\ndefault all\n\n", w.f);
+
+        // the same abs, from the same directory, with the same switches
+        char cmd[PATH_MAX * 4];
+        const char *mode = getenv("ABS_MODE");
+        size_t pos = snprintf(cmd, sizeof(cmd), "cd \"%s\" && ", cwd);
+        if (mode && *mode) pos += snprintf(cmd + pos, sizeof(cmd) - pos, "ABS_MODE=%s ", mode);
+        pos += snprintf(cmd + pos, sizeof(cmd) - pos, "\"%s\" --emit-ninja ",
+                        executor_self_path(self, sizeof(self)) == 0 ? self : "abs");
+        if (opts->modes) pos += snprintf(cmd + pos, sizeof(cmd) - pos, "--modes %s ", opts->modes);
+        if (opts->jobs > 0) pos += snprintf(cmd + pos, sizeof(cmd) - pos, "-j %d ", opts->jobs);
+        snprintf(cmd + pos, sizeof(cmd) - pos, "\"%s\"", confpath);
+
+        // named as ninja was given it, or it would not know the manifest has a rule
+        fputs("build build.ninja: regen |", w.f);
+        for (size_t i = 0; i < w.inputs_n; i++){
+            fputc(' ', w.f);
+            _ninja_escape(w.f, w.inputs[i], true);
+        }
+        fputs("\n  cmd = ", w.f);
+        _ninja_escape(w.f, cmd, false);
+        fputs("\n", w.f);
+    }
+    if (fclose(w.f) != 0) r = -1;
+    if (r == 0 && rename(tmp, path) != 0) r = -1;
+    if (r == 0) {
+        printf("%s[ninja]%s wrote %s: %zu edges, %zu configurations\n", abs_fore.blue, abs_fore.normal,
+               path, w.edges, w.configs);
+    } else {
+        unlink(tmp);
+    }
+
+    free(w.outputs);
+    free(w.inputs);
+    strtab_free(&w.names);
+    arena_free(&w.arena);
+    return r;
+}
+
+#endif
+#define ABS_NINJA
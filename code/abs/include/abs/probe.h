@@ -0,0 +1,254 @@
+#include "abs/colors.h"
+#include "abs/arena.h"
+#include <errno.h>
+#include <linux/limits.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifndef ABS_PROBE
+
+/*
+ * Compiler capability probing. A flag is supported when a trivial program
+ * compiles and links with it under -Werror. Results are cached in
+ * $XDG_CACHE_HOME/abs/probes (or ~/.cache/abs/probes), keyed by the
+ * compiler's resolved path, mtime and version line, so a probe runs once
+ * per compiler install rather than once per build. The version line is
+ * cached too, under path, mtime and size, and the records of a compiler
+ * are read once per configuration parse: a fully cached parse runs no
+ * process at all.
+ */
+
+typedef struct {
+    char *flag;
+    char *version;
+    bool  supported;
+} _probe_record;
+
+typedef struct {
+    char   path[PATH_MAX];
+    time_t mtime;
+    off_t  size;
+    char   version[256];
+    int    state;             // 0 until resolved, 1 resolved, -1 unknown compiler
+    _probe_record *records;   // cache lines of this path, mtime and size
+    size_t records_n;
+} probe_compiler;
+
+// `--version` records hold the version line of the compiler itself
+#define PROBE_VERSION_FLAG "--version"
+
+// $XDG_CACHE_HOME/abs or ~/.cache/abs, created when missing
+static int abs_cache_dir(char *out, size_t out_sz){
+    const char *xdg = getenv("XDG_CACHE_HOME");
+    const char *home = getenv("HOME");
+    char dir[PATH_MAX];
+
+    if (xdg && *xdg)       snprintf(dir, sizeof(dir), "%s/abs", xdg);
+    else if (home && *home) snprintf(dir, sizeof(dir), "%s/.cache/abs", home);
+    else return -1;
+
+    char parent[PATH_MAX];
+    snprintf(parent, sizeof(parent), "%s", dir);
+    char *slash = strrchr(parent, '/');
+    if (slash){
+        *slash = '\0';
+        mkdir(parent, 0755);
+    }
+    if (mkdir(dir, 0755) != 0 && errno != EEXIST) return -1;
+
+    snprintf(out, out_sz, "%s", dir);
+    return 0;
+}
+
+static int probe_cache_path(char *out, size_t out_sz){
+    char dir[PATH_MAX];
+    if (abs_cache_dir(dir, sizeof(dir)) != 0) return -1;
+    snprintf(out, out_sz, "%s/probes", dir);
+    return 0;
+}
+
+// resolves `cc` through $PATH the way execvp would
+static int probe_resolve_compiler(const char *cc, probe_compiler *pc){
+    memset(pc, 0, sizeof(*pc));
+    struct stat st;
+
+    if (strchr(cc, '/')){
+        if (!realpath(cc, pc->path) || stat(pc->path, &st) != 0) return -1;
+    } else {
+        const char *path_env = getenv("PATH");
+        if (!path_env) return -1;
+
+        char *paths = strdup(path_env);
+        char *saveptr = NULL;
+        int found = 0;
+        for (char *dir = strtok_r(paths, ":", &saveptr); dir; dir = strtok_r(NULL, ":", &saveptr)){
+            char candidate[PATH_MAX];
+            snprintf(candidate, sizeof(candidate), "%s/%s", dir, cc);
+            if (access(candidate, X_OK) == 0 && realpath(candidate, pc->path) && stat(pc->path, &st) == 0){
+                found = 1;
+                break;
+            }
+        }
+        free(paths);
+        if (!found) return -1;
+    }
+
+    pc->mtime = st.st_mtime;
+    pc->size = st.st_size;
+    return 0;
+}
+
+static void probe_compiler_version(const char *cc, probe_compiler *pc){
+    char cmd[PATH_MAX + 64];
+    snprintf(cmd, sizeof(cmd), "%s --version 2>/dev/null", cc);
+
+    FILE *p = popen(cmd, "r");
+    if (!p) return;
+    if (fgets(pc->version, sizeof(pc->version), p)){
+        pc->version[strcspn(pc->version, "\r\n\t")] = '\0';
+    }
+    pclose(p);
+}
+
+static void _probe_remember(probe_compiler *pc, const char *flag, const char *version, bool supported){
+    if (abs_grow(&pc->records, pc->records_n, sizeof(_probe_record)) != 0) return;
+    _probe_record *rec = &pc->records[pc->records_n++];
+    rec->flag = strdup(flag);
+    rec->version = strdup(version);
+    rec->supported = supported;
+}
+
+// keeps the cache lines of the resolved compiler, later lines override earlier ones
+static void probe_cache_load(probe_compiler *pc){
+    char cache[PATH_MAX];
+    if (probe_cache_path(cache, sizeof(cache)) != 0) return;
+
+    FILE *f = fopen(cache, "r");
+    if (!f) return;
+
+    char line[PATH_MAX + 1024];
+    while (fgets(line, sizeof(line), f)){
+        line[strcspn(line, "\n")] = '\0';
+
+        char *fields[6] = {0};
+        char *saveptr = NULL;
+        size_t n = 0;
+        for (char *tok = strtok_r(line, "\t", &saveptr); tok && n < 6; tok = strtok_r(NULL, "\t", &saveptr))
+            fields[n++] = tok;
+        if (n != 6) continue;
+
+        if (strcmp(fields[0], pc->path) == 0 &&
+            strtoll(fields[1], NULL, 10) == (long long)pc->mtime &&
+            strtoll(fields[2], NULL, 10) == (long long)pc->size){
+            _probe_remember(pc, fields[4], fields[3], fields[5][0] == '1');
+        }
+    }
+    fclose(f);
+}
+
+// returns 1/0 for a cached answer, -1 when the flag was never probed
+static int probe_cache_lookup(const probe_compiler *pc, const char *flag){
+    for (size_t i = pc->records_n; i-- > 0;){
+        const _probe_record *rec = &pc->records[i];
+        if (strcmp(rec->flag, flag) == 0 && strcmp(rec->version, pc->version) == 0) return rec->supported;
+    }
+    return -1;
+}
+
+static void probe_cache_store(probe_compiler *pc, const char *flag, int supported){
+    _probe_remember(pc, flag, pc->version, supported);
+
+    char cache[PATH_MAX];
+    if (probe_cache_path(cache, sizeof(cache)) != 0) return;
+
+    FILE *f = fopen(cache, "a");
+    if (!f) return;
+    fprintf(f, "%s\t%lld\t%lld\t%s\t%s\t%d\n", pc->path, (long long)pc->mtime,
+            (long long)pc->size, pc->version, flag, supported);
+    fclose(f);
+}
+
+/*
+ * Runs in a scratch directory, since flags like -gsplit-dwarf write side
+ * files. C++ drivers (g++, clang++, c++) compile the program as C++, so
+ * -std=c++20 is kept and C-only flags like -Wstrict-prototypes dropped.
+ */
+static int probe_run(const char *cc, const char *flag){
+    char dir[] = "/tmp/abs-probe-XXXXXX";
+    if (!mkdtemp(dir)) return 0;
+
+    char driver[PATH_MAX * 2] = {0};
+    if (cc[0] != '/' && strchr(cc, '/')){
+        char cwd[PATH_MAX];
+        if (getcwd(cwd, sizeof(cwd))) snprintf(driver, sizeof(driver), "%s/%s", cwd, cc);
+    }
+
+    const char *base = strrchr(cc, '/');
+    const char *lang = strstr(base ? base + 1 : cc, "++") ? "c++" : "c";
+
+    char cmd[PATH_MAX * 3 + 512];
+    snprintf(cmd, sizeof(cmd),
+             "cd %s && printf 'int main(void){return 0;}\\n' | %s -Werror %s -x %s - -o probe >/dev/null 2>&1",
+             dir, driver[0] ? driver : cc, flag, lang);
+    int supported = system(cmd) == 0;
+
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", dir);
+    system(cmd);
+    return supported;
+}
+
+// resolves `cc` and loads its cache lines; runs `cc --version` only when not cached
+static void probe_compiler_init(const char *cc, probe_compiler *pc){
+    if (probe_resolve_compiler(cc, pc) != 0){
+        pc->state = -1;
+        return;
+    }
+    pc->state = 1;
+    probe_cache_load(pc);
+    for (size_t i = pc->records_n; i-- > 0;){
+        if (strcmp(pc->records[i].flag, PROBE_VERSION_FLAG) == 0){
+            snprintf(pc->version, sizeof(pc->version), "%s", pc->records[i].version);
+            return;
+        }
+    }
+    probe_compiler_version(cc, pc);
+    if (!pc->version[0]) snprintf(pc->version, sizeof(pc->version), "unknown");
+    probe_cache_store(pc, PROBE_VERSION_FLAG, 1);
+}
+
+void probe_compiler_free(probe_compiler *pc){
+    for (size_t i = 0; i < pc->records_n; i++){
+        free(pc->records[i].flag);
+        free(pc->records[i].version);
+    }
+    free(pc->records);
+    pc->records = NULL;
+    pc->records_n = 0;
+}
+
+/*
+ * Returns whether `cc` accepts `flag`, probing only on a cache miss.
+ * `pc` starts zeroed, is resolved on first use and shared across calls
+ * for one compiler; release it with probe_compiler_free.
+ */
+int probe_flag(const char *cc, const char *flag, probe_compiler *pc){
+    if (pc->state == 0) probe_compiler_init(cc, pc);
+    // unknown compiler; keep the flag and let the build report it
+    if (pc->state < 0) return 1;
+
+    int cached = probe_cache_lookup(pc, flag);
+    if (cached >= 0) return cached;
+
+    int supported = probe_run(cc, flag);
+    printf("%s[probe]%s %s: %s\n", abs_fore.magenta, abs_fore.normal, flag,
+           supported ? "supported" : "unsupported, dropped");
+    probe_cache_store(pc, flag, supported);
+    return supported;
+}
+
+#endif
+#define ABS_PROBE
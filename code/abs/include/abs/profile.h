@@ -0,0 +1,233 @@
+#include "compilation.h"
+#include "arena.h"
+#include "jobs.h"
+
+#ifndef ABS_PROFILE
+
+/*
+ * `abs --profile-compile`. Every object is rebuilt with -ftime-trace
+ * (clang) or -ftime-report (gcc), then the per-object results are summed
+ * over the build:
+ *   clang: OBJECT.json next to each object; headers by total parse time
+ *          ("Source" events) and template instantiations by total time
+ *   gcc:   OBJECT.time, the -ftime-report table; gcc times compiler
+ *          passes only, so the report has passes instead of headers
+ * Both list the slowest translation units by wall time.
+ */
+
+#define ABS_PROFILE_TOP 15
+
+typedef struct {
+    const char *name;       // interned, so equal names share a pointer
+    double      ms;
+    size_t      count;      // translation units it appeared in
+} profile_entry;
+
+typedef struct {
+    abs_arena      arena;
+    abs_strtab     names;
+    profile_entry *entries;
+    size_t         n;
+} profile_table;
+
+static void _profile_add(profile_table *t, const char *name, size_t len, double ms){
+    const char *key = strtab_intern(&t->names, name, len);
+    if (!key || abs_grow(&t->entries, t->n, sizeof(profile_entry)) != 0) return;
+    t->entries[t->n++] = (profile_entry){ key, ms, 1 };
+}
+
+static int _profile_by_name(const void *a, const void *b){
+    uintptr_t x = (uintptr_t)((const profile_entry *)a)->name, y = (uintptr_t)((const profile_entry *)b)->name;
+    return (x > y) - (x < y);
+}
+
+static int _profile_by_ms(const void *a, const void *b){
+    double x = ((const profile_entry *)a)->ms, y = ((const profile_entry *)b)->ms;
+    return (x < y) - (x > y);
+}
+
+// folds equal names, then sorts by total time
+static void _profile_fold(profile_table *t){
+    if (t->n == 0) return;
+    qsort(t->entries, t->n, sizeof(profile_entry), _profile_by_name);
+    size_t out = 0;
+    for (size_t i = 1; i < t->n; i++){
+        if (t->entries[i].name == t->entries[out].name){
+            t->entries[out].ms += t->entries[i].ms;
+            t->entries[out].count += t->entries[i].count;
+        } else {
+            t->entries[++out] = t->entries[i];
+        }
+    }
+    t->n = out + 1;
+    qsort(t->entries, t->n, sizeof(profile_entry), _profile_by_ms);
+}
+
+static void _profile_table_init(profile_table *t){
+    memset(t, 0, sizeof(*t));
+    t->names.arena = &t->arena;
+}
+
+static void _profile_table_free(profile_table *t){
+    free(t->entries);
+    strtab_free(&t->names);
+    arena_free(&t->arena);
+}
+
+static const char *_profile_find(const char *from, const char *end, const char *needle){
+    size_t n = strlen(needle);
+    for (const char *p = from; p + n <= end; p++){
+        if (memcmp(p, needle, n) == 0) return p;
+    }
+    return NULL;
+}
+
+// a JSON string value starting after its opening quote, unescaped into `out`
+static size_t _profile_json_string(const char *p, const char *end, char *out, size_t out_sz){
+    size_t n = 0;
+    for (; p < end && *p != '"'; p++){
+        char c = *p;
+        if (c == '\\' && p + 1 < end){
+            c = *++p;
+            if (c == 'n' || c == 't') c = ' ';
+        }
+        if (n + 1 < out_sz) out[n++] = c;
+    }
+    out[n] = '\0';
+    return n;
+}
+
+/*
+ * Clang's trace is one flat event object per span, e.g.
+ *   {"pid":1,"tid":2,"ph":"X","ts":10,"dur":250,"name":"Source","args":{"detail":"a.h"}}
+ * so each event is read between its `{` and the `},{` that ends it.
+ */
+static void _profile_read_trace(const char *path, profile_table *headers, profile_table *templates){
+    size_t len = 0;
+    char *data = exec_read_file(path, &len);
+    if (!data) return;
+    const char *end = data + len;
+
+    for (const char *p = _profile_find(data, end, "\"name\":\""); p; p = _profile_find(p + 1, end, "\"name\":\"")){
+        const char *ev = p;
+        while (ev > data && *ev != '{') ev--;
+        const char *ev_end = _profile_find(p, end, "},{");
+        if (!ev_end) ev_end = end;
+
+        char name[64];
+        _profile_json_string(p + 8, ev_end, name, sizeof(name));
+        profile_table *t = strcmp(name, "Source") == 0 ? headers
+                         : strncmp(name, "Instantiate", 11) == 0 ? templates : NULL;
+        const char *dur = t ? _profile_find(ev, ev_end, "\"dur\":") : NULL;
+        const char *detail = dur ? _profile_find(ev, ev_end, "\"detail\":\"") : NULL;
+        if (!detail) continue;
+
+        char what[1024];
+        size_t what_n = _profile_json_string(detail + 10, ev_end, what, sizeof(what));
+        _profile_add(t, what, what_n, strtod(dur + 6, NULL) / 1000.0);
+    }
+    free(data);
+}
+
+//  name  :  usr ( p%)  sys ( p%)  wall ( p%)  GGC
+static void _profile_read_report(const char *path, profile_table *passes){
+    FILE *f = fopen(path, "r");
+    if (!f) return;
+    char line[512];
+    bool table = false;
+    while (fgets(line, sizeof(line), f)){
+        if (strncmp(line, "Time variable", 13) == 0){
+            table = true;
+            continue;
+        }
+        char *colon = strchr(line, ':');
+        if (!table || !colon) continue;
+
+        double usr, sys, wall;
+        if (sscanf(colon + 1, " %lf ( %*d%%) %lf ( %*d%%) %lf", &usr, &sys, &wall) != 3) continue;
+        char *name = line, *name_end = colon;
+        while (*name == ' ') name++;
+        while (name_end > name && name_end[-1] == ' ') name_end--;
+        if (name_end - name == 5 && strncmp(name, "TOTAL", 5) == 0) continue;
+        _profile_add(passes, name, name_end - name, wall * 1000.0);
+    }
+    fclose(f);
+}
+
+static void _profile_print(const char *title, const profile_table *t){
+    if (t->n == 0) return;
+    const char *c = abs_fore.blue, *n = abs_fore.normal;
+    printf("%s[profile]%s %s\n", c, n, title);
+    for (size_t i = 0; i < t->n && i < ABS_PROFILE_TOP; i++){
+        const profile_entry *e = &t->entries[i];
+        printf("%s[profile]%s   %10.1f ms %6zux  %s\n", c, n, e->ms, e->count, e->name);
+    }
+    if (t->n > ABS_PROFILE_TOP) printf("%s[profile]%s   ... %zu more\n", c, n, t->n - ABS_PROFILE_TOP);
+}
+
+// object of a compile job, from its log path `OBJECT.log`
+static int _profile_object(const abs_job *j, char *out, size_t out_sz){
+    size_t len = j->log_path ? strlen(j->log_path) : 0;
+    if (len < 4 || strcmp(j->log_path + len - 4, ".log") != 0) return -1;
+    snprintf(out, out_sz, "%.*s", (int)(len - 4), j->log_path);
+    return 0;
+}
+
+void profile_report(const compiler_conf *cfg, const job_list *jl){
+    if (!cfg->profile) return;
+    bool clang = is_clang(cfg);
+    profile_table units, headers, templates, passes;
+    _profile_table_init(&units);
+    _profile_table_init(&headers);
+    _profile_table_init(&templates);
+    _profile_table_init(&passes);
+
+    double total = 0;
+    for (size_t i = 0; i < jl->n; i++){
+        const abs_job *j = &jl->jobs[i];
+        char obj[PATH_MAX], path[PATH_MAX + 16];
+        if (j->kind != JOB_COMPILE || j->state != JOB_OK || !j->started.tv_sec) continue;
+        if (_profile_object(j, obj, sizeof(obj)) != 0) continue;
+
+        double ms = jobs_elapsed_ms(j);
+        total += ms;
+        _profile_add(&units, j->label, strlen(j->label), ms);
+        if (clang){
+            // the trace follows the -o name: x.o -> x.json, or x.o.json when restat compiled to x.o.tmp
+            char other[PATH_MAX + 16];
+            struct stat a, b;
+            char *dot = strrchr(obj, '.');
+            snprintf(path, sizeof(path), "%.*s.json", dot ? (int)(dot - obj) : (int)strlen(obj), obj);
+            snprintf(other, sizeof(other), "%s.json", obj);
+            if (stat(other, &b) == 0 && (stat(path, &a) != 0 || b.st_mtime > a.st_mtime))
+                snprintf(path, sizeof(path), "%s", other);
+            _profile_read_trace(path, &headers, &templates);
+        } else {
+            snprintf(path, sizeof(path), "%s.time", obj);
+            _profile_read_report(path, &passes);
+        }
+    }
+
+    _profile_fold(&units);
+    _profile_fold(&headers);
+    _profile_fold(&templates);
+    _profile_fold(&passes);
+
+    printf("\n%s[profile]%s %zu translation units, %.1f ms of compiling\n",
+           abs_fore.blue, abs_fore.normal, units.n, total);
+    _profile_print("slowest translation units", &units);
+    _profile_print("headers by total parse time", &headers);
+    _profile_print("template instantiations by total time", &templates);
+    _profile_print("compiler passes by total time (-ftime-report)", &passes);
+    if (!clang && units.n){
+        printf("%s[profile]%s headers and templates need clang's -ftime-trace\n", abs_fore.blue, abs_fore.normal);
+    }
+
+    _profile_table_free(&units);
+    _profile_table_free(&headers);
+    _profile_table_free(&templates);
+    _profile_table_free(&passes);
+}
+
+#endif
+#define ABS_PROFILE
@@ -0,0 +1,579 @@
+#include "compilation.h"
+#include <dirent.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/inotify.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#ifndef ABS_SERVER
+
+/*
+ * Build server. `abs --server` keeps the parsed configuration and a warm
+ * header cache in memory and watches the project tree with inotify. A
+ * plain `abs` in the same directory connects to its Unix socket instead
+ * of starting cold. When nothing in the tree changed since the last
+ * successful build the server answers without touching the filesystem;
+ * otherwise it forks a build from its in-memory state, streaming output
+ * back to the client.
+ *
+ * Wire protocol, one request per connection:
+ *   client: `build <force> <keep_going> <jobs> <progress>\n` or `stop\n`
+ *   server: build output, then `\x1e<exit status>\n`
+ */
+
+#define ABS_SERVER_TRAILER '\x1e'
+
+// written next to objects, wherever a module keeps them; events on them never make the tree dirty
+static const char *server_ignored_ext[] = {
+    ".o", ".sig", ".log", ".cmd", ".tmp", ".stamp", ".rsp", ".gcm", ".pcm", ".dwo", ".dwp", NULL
+};
+
+// version control state is not a build input and can be large
+static const char *server_skipped_dirs[] = { ".git", ".hg", ".svn", NULL };
+
+typedef struct {
+    int   wd;
+    char *path;
+} server_watch;
+
+typedef struct {
+    const char *prog;
+    char   confpath[PATH_MAX];
+    char   config_dir[PATH_MAX];
+    char   conf_name[NAME_MAX + 1];
+
+    ini_config    ini;
+    compiler_conf cfg;
+    bool   loaded;
+    char   obj_dir[PATH_MAX * 2];  // absolute, the directory may come and go with cleanup
+
+    int    inotify;
+    server_watch *watches;
+    size_t watches_n;
+
+    bool   dirty;          // something changed since the last build
+    bool   reload;         // abs.conf itself changed
+    bool   clean;          // the last build succeeded
+    struct timespec out_mtime;
+} server_state;
+
+typedef int (*server_build_fn)(const char *prog, const char *confpath, ini_config *ini, const build_opts *opts);
+
+static volatile sig_atomic_t server_stop_requested = 0;
+
+static void _server_on_signal(int sig){
+    (void)sig;
+    server_stop_requested = 1;
+}
+
+/*
+ * One socket per (working directory, config) pair, since paths in a config
+ * are relative to the directory abs runs in. Lives in $XDG_RUNTIME_DIR, or
+ * /tmp with the uid in the name.
+ */
+int server_socket_path(const char *confpath, char *out, size_t out_sz){
+    char cwd[PATH_MAX], conf[PATH_MAX];
+    if (!getcwd(cwd, sizeof(cwd)) || !realpath(confpath, conf)) return -1;
+
+    char key[PATH_MAX * 2 + 2];
+    int len = snprintf(key, sizeof(key), "%s\n%s", cwd, conf);
+    unsigned long long h = (unsigned long long)depscan_hash(key, len);
+
+    const char *runtime = getenv("XDG_RUNTIME_DIR");
+    if (runtime && *runtime) snprintf(out, out_sz, "%s/abs-%016llx.sock", runtime, h);
+    else snprintf(out, out_sz, "/tmp/abs-%u-%016llx.sock", (unsigned)getuid(), h);
+
+    return strlen(out) < sizeof(((struct sockaddr_un*)0)->sun_path) ? 0 : -1;
+}
+
+// server_socket_path already checked that the path fits
+static void _server_addr(struct sockaddr_un *addr, const char *sock_path){
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    size_t len = strlen(sock_path);
+    if (len >= sizeof(addr->sun_path)) len = sizeof(addr->sun_path) - 1;
+    memcpy(addr->sun_path, sock_path, len);
+}
+
+static int _server_connect(const char *sock_path){
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+
+    struct sockaddr_un addr;
+    _server_addr(&addr, sock_path);
+
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0){
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static int _server_write_all(int fd, const char *buf, size_t len){
+    while (len > 0){
+        ssize_t w = write(fd, buf, len);
+        if (w < 0){
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        buf += w;
+        len -= w;
+    }
+    return 0;
+}
+
+/*
+ * Sends `request` to a running server and relays its output. Returns the
+ * build's exit status, or -2 when no server is listening.
+ */
+int server_client_request(const char *confpath, const char *request){
+    char sock_path[PATH_MAX];
+    if (server_socket_path(confpath, sock_path, sizeof(sock_path)) != 0) return -2;
+
+    int fd = _server_connect(sock_path);
+    if (fd < 0) return -2;
+
+    if (_server_write_all(fd, request, strlen(request)) != 0){
+        close(fd);
+        return -2;
+    }
+
+    char buf[4096];
+    char status[32] = {0};
+    size_t status_len = 0;
+    bool in_trailer = false;
+
+    ssize_t r;
+    while ((r = read(fd, buf, sizeof(buf))) != 0){
+        if (r < 0){
+            if (errno == EINTR) continue;
+            break;
+        }
+
+        char *p = buf;
+        size_t len = r;
+        if (!in_trailer){
+            char *t = memchr(buf, ABS_SERVER_TRAILER, r);
+            size_t out_len = t ? (size_t)(t - buf) : (size_t)r;
+            fwrite(buf, 1, out_len, stdout);
+            if (!t) continue;
+            in_trailer = true;
+            p = t + 1;
+            len = r - out_len - 1;
+        }
+        while (len-- > 0 && status_len + 1 < sizeof(status)) status[status_len++] = *p++;
+    }
+    fflush(stdout);
+    close(fd);
+
+    // the server went away mid-build
+    if (!in_trailer) return -1;
+    return atoi(status);
+}
+
+int server_client_build(const char *confpath, const build_opts *opts){
+    char request[64];
+    snprintf(request, sizeof(request), "build %d %d %d %d\n", opts->force_recompile, opts->keep_going ? 1 : 0,
+             opts->jobs, (int)opts->progress);
+    return server_client_request(confpath, request);
+}
+
+static bool _server_ignored_name(const char *name){
+    size_t len = strlen(name);
+    for (int i = 0; server_ignored_ext[i] != NULL; i++){
+        size_t ext_len = strlen(server_ignored_ext[i]);
+        if (len > ext_len && strcmp(name + len - ext_len, server_ignored_ext[i]) == 0) return true;
+    }
+    return false;
+}
+
+/*
+ * The objects directory only holds build state. It is not watched, unless
+ * it is the project directory itself; the output directory often is (`.`
+ * by default), so only the output files are left out, by name.
+ */
+static bool _server_is_obj_dir(const server_state *s, const char *path){
+    return *s->obj_dir && strcmp(s->obj_dir, path) == 0 && strcmp(path, s->config_dir) != 0;
+}
+
+// the output, its restat temporary and its .dwp package
+static bool _server_is_product(const server_state *s, const char *dir, const char *name){
+    if (!s->cfg.output || !s->cfg.out_dir) return false;
+    char out_path[PATH_MAX], real[PATH_MAX];
+    get_output_path(&s->cfg, out_path, sizeof(out_path));
+    char *slash = strrchr(out_path, '/');
+    if (!slash) return false;
+    *slash = '\0';
+    if (!realpath(out_path, real) || strcmp(real, dir) != 0) return false;
+
+    const char *base = slash + 1;
+    size_t len = strlen(base);
+    return strncmp(name, base, len) == 0 &&
+           (name[len] == '\0' || strcmp(name + len, ".tmp") == 0 || strcmp(name + len, ".dwp") == 0);
+}
+
+static void _server_watch_tree(server_state *s, const char *path){
+    for (size_t i = 0; i < s->watches_n; i++){
+        if (strcmp(s->watches[i].path, path) == 0) return;
+    }
+    if (_server_is_obj_dir(s, path)) return;
+
+    int wd = inotify_add_watch(s->inotify, path,
+                               IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM |
+                               IN_MOVED_TO | IN_ATTRIB | IN_DELETE_SELF | IN_ONLYDIR);
+    if (wd < 0) return;
+
+    server_watch *tmp = realloc(s->watches, sizeof(server_watch) * (s->watches_n + 1));
+    if (!tmp) return;
+    s->watches = tmp;
+    s->watches[s->watches_n].wd = wd;
+    s->watches[s->watches_n++].path = strdup(path);
+
+    DIR *dp = opendir(path);
+    if (!dp) return;
+    struct dirent *ep;
+    while ((ep = readdir(dp))){
+        if (strcmp(ep->d_name, ".") == 0 || strcmp(ep->d_name, "..") == 0) continue;
+        bool skipped = false;
+        for (int i = 0; server_skipped_dirs[i]; i++) skipped |= strcmp(ep->d_name, server_skipped_dirs[i]) == 0;
+        if (skipped) continue;
+
+        char child[PATH_MAX];
+        snprintf(child, sizeof(child), "%s/%s", path, ep->d_name);
+        struct stat st;
+        if (stat(child, &st) == 0 && S_ISDIR(st.st_mode)) _server_watch_tree(s, child);
+    }
+    closedir(dp);
+}
+
+static const char *_server_watch_path(const server_state *s, int wd){
+    for (size_t i = 0; i < s->watches_n; i++){
+        if (s->watches[i].wd == wd) return s->watches[i].path;
+    }
+    return NULL;
+}
+
+static void _server_unload(server_state *s){
+    if (!s->loaded) return;
+    // the objects directory belongs to builds, never to the server
+    s->cfg.cleanup = false;
+    compiler_conf_free(&s->cfg);
+    ini_clear_config(&s->ini);
+    s->loaded = false;
+}
+
+/*
+ * A changed config is parsed in a throwaway child first, so its
+ * diagnostics go to `report_fd` and a broken edit keeps the old state.
+ */
+static int _server_validate(const server_state *s, int report_fd){
+    fflush(stdout);
+    fflush(stderr);
+
+    pid_t pid = fork();
+    if (pid < 0) return -1;
+    if (pid == 0){
+        if (report_fd >= 0){
+            dup2(report_fd, STDOUT_FILENO);
+            dup2(report_fd, STDERR_FILENO);
+        }
+        ini_config ini;
+        compiler_conf cfg;
+        memset(&cfg, 0, sizeof(cfg));
+        if (0 > ini_load_file(&ini, s->confpath)) _exit(1);
+        int r = ini_check(&ini, "files") == 0 ? config_ini_parse(&ini, &cfg) : 0;
+        fflush(stdout);
+        fflush(stderr);
+        _exit(r == 0 ? 0 : 1);
+    }
+
+    int status;
+    while (waitpid(pid, &status, 0) < 0 && errno == EINTR);
+    return (WIFEXITED(status) && WEXITSTATUS(status) == 0) ? 0 : -1;
+}
+
+static int _server_load(server_state *s, int report_fd){
+    if (_server_validate(s, report_fd) != 0){
+        fprintf(stderr, "%s[server]%s failed to load %s\n", abs_fore.red, abs_fore.normal, s->confpath);
+        return -1;
+    }
+    _server_unload(s);
+
+    if (0 > ini_load_file(&s->ini, s->confpath)) return -1;
+    memset(&s->cfg, 0, sizeof(s->cfg));
+    if (ini_check(&s->ini, "files") == 0) config_ini_parse(&s->ini, &s->cfg);
+    s->loaded = true;
+
+    char cwd[PATH_MAX];
+    const char *obj = s->cfg.obj_dir;
+    *s->obj_dir = '\0';
+    if (obj && !realpath(obj, s->obj_dir) && getcwd(cwd, sizeof(cwd))){
+        while (obj[0] == '.' && obj[1] == '/') obj += 2;
+        if (obj[0] == '/') snprintf(s->obj_dir, sizeof(s->obj_dir), "%s", obj);
+        else snprintf(s->obj_dir, sizeof(s->obj_dir), "%s/%s", cwd, obj);
+    }
+
+    // warm the header cache; forked builds inherit it
+    for (size_t i = 0; i < s->cfg.sources_n; i++){
+        char src_full[PATH_MAX];
+        snprintf(src_full, sizeof(src_full), "%s/%s", s->cfg.src_dir ? s->cfg.src_dir : ".", s->cfg.sources[i]);
+        depscan_deps deps;
+        depscan_collect(&s->cfg, src_full, &deps);
+        depscan_deps_free(&deps);
+    }
+
+    _server_watch_tree(s, s->config_dir);
+    for (size_t i = 0; i < s->cfg.include_n; i++){
+        char real[PATH_MAX];
+        if (realpath(s->cfg.include_dirs[i], real)) _server_watch_tree(s, real);
+    }
+
+    s->reload = false;
+    s->dirty = true;
+    return 0;
+}
+
+static void _server_drain_events(server_state *s){
+    char buf[16384] __attribute__((aligned(__alignof__(struct inotify_event))));
+
+    for (;;){
+        ssize_t len = read(s->inotify, buf, sizeof(buf));
+        if (len <= 0) return;
+
+        for (char *p = buf; p < buf + len; ){
+            const struct inotify_event *ev = (const struct inotify_event *)p;
+            p += sizeof(struct inotify_event) + ev->len;
+
+            if (ev->mask & IN_Q_OVERFLOW){
+                s->dirty = true;
+                continue;
+            }
+
+            const char *dir = _server_watch_path(s, ev->wd);
+            if (!dir) continue;
+
+            if (ev->len == 0){
+                // the watched directory itself went away
+                s->dirty = true;
+                continue;
+            }
+
+            char child[PATH_MAX];
+            snprintf(child, sizeof(child), "%s/%s", dir, ev->name);
+            if (_server_is_obj_dir(s, child)) continue;
+            if ((ev->mask & IN_ISDIR) && (ev->mask & (IN_CREATE | IN_MOVED_TO))) _server_watch_tree(s, child);
+
+            if (strcmp(dir, s->config_dir) == 0 && strcmp(ev->name, s->conf_name) == 0){
+                s->reload = true;
+                s->dirty = true;
+                continue;
+            }
+
+            if (_server_ignored_name(ev->name) || _server_is_product(s, dir, ev->name)) continue;
+            s->dirty = true;
+        }
+    }
+}
+
+static bool _server_output_unchanged(const server_state *s){
+    if (!s->cfg.output) return true;
+
+    char out_path[PATH_MAX];
+    get_output_path(&s->cfg, out_path, sizeof(out_path));
+    struct stat st;
+    return stat(out_path, &st) == 0 &&
+           st.st_mtim.tv_sec == s->out_mtime.tv_sec &&
+           st.st_mtim.tv_nsec == s->out_mtime.tv_nsec;
+}
+
+static void _server_reply_status(int fd, int status){
+    char trailer[32];
+    int len = snprintf(trailer, sizeof(trailer), "%c%d\n", ABS_SERVER_TRAILER, status);
+    _server_write_all(fd, trailer, len);
+}
+
+static int _server_build(server_state *s, int client, int listen_fd, const build_opts *opts, server_build_fn fn){
+    fflush(stdout);
+    fflush(stderr);
+
+    pid_t pid = fork();
+    if (pid < 0) return -1;
+
+    if (pid == 0){
+        close(listen_fd);
+        close(s->inotify);
+        dup2(client, STDOUT_FILENO);
+        dup2(client, STDERR_FILENO);
+        close(client);
+        int r = fn(s->prog, s->confpath, &s->ini, opts);
+        fflush(stdout);
+        exit(r == 0 ? 0 : 1);
+    }
+
+    int status;
+    while (waitpid(pid, &status, 0) < 0 && errno == EINTR);
+    int rc = (WIFEXITED(status) && WEXITSTATUS(status) == 0) ? 0 : 1;
+
+    s->clean = rc == 0;
+    memset(&s->out_mtime, 0, sizeof(s->out_mtime));
+    if (s->clean && s->cfg.output){
+        char out_path[PATH_MAX];
+        struct stat st;
+        get_output_path(&s->cfg, out_path, sizeof(out_path));
+        if (stat(out_path, &st) == 0) s->out_mtime = st.st_mtim;
+    }
+    return rc;
+}
+
+static void _server_handle(server_state *s, int client, int listen_fd, server_build_fn fn){
+    char request[256] = {0};
+    size_t len = 0;
+    while (len + 1 < sizeof(request)){
+        ssize_t r = read(client, request + len, 1);
+        if (r <= 0 || request[len] == '\n') break;
+        len++;
+    }
+    request[len] = '\0';
+
+    if (strcmp(request, "stop") == 0){
+        printf("%s[server]%s stop requested\n", abs_fore.yellow, abs_fore.normal);
+        _server_reply_status(client, 0);
+        server_stop_requested = 1;
+        return;
+    }
+
+    build_opts opts = {0};
+    int keep_going = 0, progress = 0;
+    if (sscanf(request, "build %d %d %d %d", &opts.force_recompile, &keep_going, &opts.jobs, &progress) != 4 ||
+        progress < JOBS_OUTPUT_PLAIN || progress > JOBS_OUTPUT_STATUS){
+        dprintf(client, "%s[server]%s bad request: %s\n", abs_fore.red, abs_fore.normal, request);
+        _server_reply_status(client, 1);
+        return;
+    }
+    opts.keep_going = keep_going;
+    opts.progress = (jobs_output)progress;
+
+    _server_drain_events(s);
+    if (s->reload && _server_load(s, client) != 0){
+        dprintf(client, "%s[server]%s failed to reload %s\n", abs_fore.red, abs_fore.normal, s->confpath);
+        _server_reply_status(client, 1);
+        return;
+    }
+
+    if (!s->dirty && s->clean && !opts.force_recompile && _server_output_unchanged(s)){
+        dprintf(client, "%s[server]%s no changes since the last build, %s is up to date\n",
+                abs_fore.cyan, abs_fore.normal, s->cfg.output ? s->cfg.output : "project");
+        _server_reply_status(client, 0);
+        return;
+    }
+
+    // events from here on belong to the next request
+    s->dirty = false;
+    int rc = _server_build(s, client, listen_fd, &opts, fn);
+    printf("%s[server]%s build %s\n", abs_fore.blue, abs_fore.normal, rc == 0 ? "succeeded" : "failed");
+    _server_reply_status(client, rc);
+}
+
+/*
+ * Runs the server in the foreground until SIGINT/SIGTERM or `abs --stop-server`.
+ */
+int server_run(const char *prog, const char *confpath, server_build_fn fn){
+    server_state s;
+    memset(&s, 0, sizeof(s));
+
+    // module builds re-exec abs, so the path must survive chdir
+    static char self[PATH_MAX];
+    ssize_t self_len = readlink("/proc/self/exe", self, sizeof(self) - 1);
+    if (self_len > 0){
+        self[self_len] = '\0';
+        s.prog = self;
+    } else {
+        s.prog = prog;
+    }
+
+    if (!realpath(confpath, s.confpath)){
+        fprintf(stderr, "%s[server]%s config not found: %s\n", abs_fore.red, abs_fore.normal, confpath);
+        return -1;
+    }
+    snprintf(s.config_dir, sizeof(s.config_dir), "%s", s.confpath);
+    char *slash = strrchr(s.config_dir, '/');
+    snprintf(s.conf_name, sizeof(s.conf_name), "%s", slash + 1);
+    *slash = '\0';
+
+    char sock_path[PATH_MAX];
+    if (server_socket_path(confpath, sock_path, sizeof(sock_path)) != 0){
+        fprintf(stderr, "%s[server]%s socket path too long\n", abs_fore.red, abs_fore.normal);
+        return -1;
+    }
+
+    int probe = _server_connect(sock_path);
+    if (probe >= 0){
+        close(probe);
+        fprintf(stderr, "%s[server]%s already running on %s\n", abs_fore.red, abs_fore.normal, sock_path);
+        return -1;
+    }
+    unlink(sock_path); // stale socket from a killed server
+
+    int listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    struct sockaddr_un addr;
+    _server_addr(&addr, sock_path);
+    if (listen_fd < 0 || bind(listen_fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(listen_fd, 16) != 0){
+        fprintf(stderr, "%s[server]%s cannot listen on %s: %s\n", abs_fore.red, abs_fore.normal, sock_path, strerror(errno));
+        if (listen_fd >= 0) close(listen_fd);
+        return -1;
+    }
+
+    s.inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (s.inotify < 0 || _server_load(&s, -1) != 0){
+        close(listen_fd);
+        unlink(sock_path);
+        return -1;
+    }
+
+    struct sigaction sa = {0};
+    sa.sa_handler = _server_on_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    printf("%s[server]%s listening on %s, watching %zu directories\n",
+           abs_fore.green, abs_fore.normal, sock_path, s.watches_n);
+    fflush(stdout);
+
+    while (!server_stop_requested){
+        struct pollfd fds[2] = {
+            { .fd = listen_fd, .events = POLLIN },
+            { .fd = s.inotify, .events = POLLIN },
+        };
+        if (poll(fds, 2, -1) < 0){
+            if (errno == EINTR) continue;
+            break;
+        }
+
+        if (fds[1].revents & POLLIN) _server_drain_events(&s);
+
+        if (fds[0].revents & POLLIN){
+            int client = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC);
+            if (client < 0) continue;
+            _server_handle(&s, client, listen_fd, fn);
+            close(client);
+            fflush(stdout);
+        }
+    }
+
+    close(listen_fd);
+    unlink(sock_path);
+    close(s.inotify);
+    for (size_t i = 0; i < s.watches_n; i++) free(s.watches[i].path);
+    free(s.watches);
+    _server_unload(&s);
+    depscan_cache_free(&abs_depscan_cache);
+
+    printf("%s[server]%s stopped\n", abs_fore.yellow, abs_fore.normal);
+    return 0;
+}
+
+#endif
+#define ABS_SERVER
@@ -0,0 +1,267 @@
+#include "configuration.h"
+#include "executor.h"
+#include "modules.h"
+#include <ctype.h>
+#include <elf.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifndef ABS_SHARED
+
+/*
+ * Load-time options of `build = shared` ([compiler] shared_opt). Objects
+ * are compiled with hidden visibility and the library links against a
+ * generated version script, so only the chosen symbols are exported and
+ * the dynamic linker has less to look up and relocate at dlopen time.
+ *
+ * Exports come from [shared] exports (names or version script globs) and
+ * from declarations in [shared] headers marked with `macro`, by default
+ * ABS_EXPORT, which abs defines to default visibility when compiling.
+ * C++ libraries also get every name in an `extern "C++"` block, matched
+ * against demangled symbols, with or without a scope and parameters.
+ */
+
+static bool is_shared_build(const compiler_conf *cfg){
+    return cfg->build_type && strcmp(cfg->build_type, "shared") == 0;
+}
+
+static bool shared_opt(const compiler_conf *cfg, unsigned bit){
+    return is_shared_build(cfg) && (cfg->shared_opt & bit);
+}
+
+/*
+ * Hidden visibility would hide the [shared] exports listed by name, so it
+ * only applies when there is no such list or headers annotate exports.
+ */
+static bool shared_hidden(const compiler_conf *cfg){
+    return shared_opt(cfg, SHARED_OPT_VISIBILITY) && (cfg->exports_n == 0 || cfg->export_headers_n > 0);
+}
+
+static size_t build_shared_cflags(const compiler_conf *cfg, char *out_buf, size_t out_sz, size_t pos){
+    if (shared_hidden(cfg)){
+        pos += snprintf(out_buf + pos, out_sz - pos, "-fvisibility=hidden ");
+    }
+    if (shared_opt(cfg, SHARED_OPT_SYMBOLIC)){
+        pos += snprintf(out_buf + pos, out_sz - pos, "-fno-semantic-interposition ");
+    }
+    if (is_shared_build(cfg) && cfg->shared_opt && cfg->export_headers_n){
+        pos += snprintf(out_buf + pos, out_sz - pos,
+                        "\"-D%s=__attribute__((visibility(\\\"default\\\")))\" ", cfg->export_macro);
+    }
+    return pos;
+}
+
+static size_t build_shared_ldflags(const compiler_conf *cfg, const char *version_script,
+                                   char *out_buf, size_t out_sz, size_t pos){
+    if (shared_opt(cfg, SHARED_OPT_SYMBOLIC))
+        pos += snprintf(out_buf + pos, out_sz - pos, "-Wl,-Bsymbolic-functions ");
+    if (shared_opt(cfg, SHARED_OPT_GNU_HASH))
+        pos += snprintf(out_buf + pos, out_sz - pos, "-Wl,--hash-style=gnu ");
+    if (shared_opt(cfg, SHARED_OPT_AS_NEEDED))
+        pos += snprintf(out_buf + pos, out_sz - pos, "-Wl,--as-needed ");
+    if (shared_opt(cfg, SHARED_OPT_NOW))
+        pos += snprintf(out_buf + pos, out_sz - pos, "-Wl,-z,now ");
+    if (shared_opt(cfg, SHARED_OPT_RELRO))
+        pos += snprintf(out_buf + pos, out_sz - pos, "-Wl,-z,relro ");
+    if (version_script)
+        pos += snprintf(out_buf + pos, out_sz - pos, "-Wl,--version-script=\"%s\" ", version_script);
+    return pos;
+}
+
+typedef struct {
+    char  *buf;
+    size_t len;
+    size_t cap;
+} _shared_buf;
+
+static void _shared_append(_shared_buf *b, const char *s, size_t len){
+    if (b->len + len + 1 > b->cap){
+        size_t cap = b->cap ? b->cap * 2 : 1024;
+        while (cap < b->len + len + 1) cap *= 2;
+        char *tmp = realloc(b->buf, cap);
+        if (!tmp) return;
+        b->buf = tmp;
+        b->cap = cap;
+    }
+    memcpy(b->buf + b->len, s, len);
+    b->len += len;
+    b->buf[b->len] = '\0';
+}
+
+static void _shared_add_symbol(_shared_buf *b, const char *name, size_t len){
+    _shared_append(b, "    ", 4);
+    _shared_append(b, name, len);
+    _shared_append(b, ";\n", 2);
+}
+
+/*
+ * `name`, `name(...)`, `scope::name` and `scope::name(...)` as demangled
+ * patterns. Version scripts reject `(` and match quoted names literally,
+ * so the parameter list is any character that cannot continue the name.
+ */
+static void _shared_add_cxx_symbol(_shared_buf *b, const char *name, size_t len){
+    static const char *forms[][2] = {
+        { "", "" }, { "", "[!a-zA-Z0-9_]*" }, { "*::", "" }, { "*::", "[!a-zA-Z0-9_]*" },
+    };
+    for (size_t i = 0; i < sizeof(forms) / sizeof(forms[0]); i++){
+        _shared_append(b, "      ", 6);
+        _shared_append(b, forms[i][0], strlen(forms[i][0]));
+        _shared_append(b, name, len);
+        _shared_append(b, forms[i][1], strlen(forms[i][1]));
+        _shared_append(b, ";\n", 2);
+    }
+}
+
+// a C++ driver, or C++ sources; their symbols are mangled
+static bool _shared_is_cxx(const compiler_conf *cfg){
+    if (cfg->compiler && strstr(cfg->compiler, "++")) return true;
+    for (size_t i = 0; i < cfg->sources_n; i++){
+        if (is_cxx_source(cfg->sources[i])) return true;
+    }
+    return false;
+}
+
+/*
+ * Every `MACRO ... name(` or `MACRO ... name;` outside preprocessor lines
+ * and comments names an export: the identifier right before the first
+ * `(`, `;`, `=` or `[` after the macro. Names go to `b` one per line.
+ */
+static size_t _shared_scan_header(const char *path, const char *macro, _shared_buf *b){
+    size_t len = 0, found = 0, mlen = strlen(macro);
+    char *src = exec_read_file(path, &len);
+    if (!src) return 0;
+    source_blank_comments(src, false);
+
+    for (char *p = strstr(src, macro); p; p = strstr(p + mlen, macro)){
+        if ((p > src && source_ident(p[-1])) || source_ident(p[mlen])) continue;
+
+        const char *line = p;
+        while (line > src && line[-1] != '\n') line--;
+        while (*line == ' ' || *line == '\t') line++;
+        if (*line == '#') continue;
+
+        const char *end = p + mlen;
+        while (*end && !strchr("(;=[{", *end)) end++;
+        const char *name_end = end;
+        while (name_end > p + mlen && isspace((unsigned char)name_end[-1])) name_end--;
+        const char *name = name_end;
+        while (name > p + mlen && source_ident(name[-1])) name--;
+        if (name == name_end) continue;
+
+        _shared_append(b, name, name_end - name);
+        _shared_append(b, "\n", 1);
+        found++;
+    }
+    free(src);
+    return found;
+}
+
+/*
+ * Writes `<objects>/<output>.map` when the library has an export list,
+ * leaving an identical file alone so the link is not redone for nothing.
+ * Returns 1 with the path in `out` when a version script applies.
+ */
+int shared_write_version_script(const compiler_conf *cfg, char *out, size_t out_sz){
+    if (!is_shared_build(cfg) || !cfg->shared_opt || (cfg->exports_n == 0 && cfg->export_headers_n == 0))
+        return 0;
+
+    _shared_buf names = {0};
+    for (size_t i = 0; i < cfg->exports_n; i++){
+        _shared_append(&names, cfg->exports[i], strlen(cfg->exports[i]));
+        _shared_append(&names, "\n", 1);
+    }
+    for (size_t i = 0; i < cfg->export_headers_n; i++){
+        if (_shared_scan_header(cfg->export_headers[i], cfg->export_macro, &names) == 0){
+            fprintf(stderr, "%s[warn]%s %s: no %s declarations\n", abs_fore.yellow, abs_fore.normal,
+                    cfg->export_headers[i], cfg->export_macro);
+        }
+    }
+
+    // plain names stay for C and extern "C" symbols of a C++ library
+    bool cxx = _shared_is_cxx(cfg);
+    _shared_buf b = {0};
+    const char *head = "/* generated by abs from [shared], do not edit */\n{\n  global:\n";
+    _shared_append(&b, head, strlen(head));
+    for (int pass = 0; pass < (cxx ? 2 : 1); pass++){
+        if (pass == 1) _shared_append(&b, "    extern \"C++\" {\n", 19);
+        for (const char *n = names.buf; n && *n; ){
+            const char *end = strchr(n, '\n');
+            if (pass == 0) _shared_add_symbol(&b, n, end - n);
+            else _shared_add_cxx_symbol(&b, n, end - n);
+            n = end + 1;
+        }
+        if (pass == 1) _shared_append(&b, "    };\n", 7);
+    }
+    free(names.buf);
+    const char *tail = "  local: *;\n};\n";
+    _shared_append(&b, tail, strlen(tail));
+    if (!b.buf) return -1;
+
+    snprintf(out, out_sz, "%s/%s.map", cfg->obj_dir, cfg->output);
+    size_t old_len = 0;
+    char *old = exec_read_file(out, &old_len);
+    int same = old && old_len == b.len && memcmp(old, b.buf, b.len) == 0;
+    free(old);
+
+    int r = same || cfg->dry_run ? 0 : exec_write_file(out, b.buf, b.len);
+    free(b.buf);
+    return r == 0 ? 1 : -1;
+}
+
+/*
+ * Counts what a shared library exports: defined, global or weak symbols
+ * of default or protected visibility in .dynsym. Returns -1 for anything
+ * but a 64-bit ELF file.
+ */
+int shared_count_exports(const char *path, size_t *functions, size_t *objects){
+    *functions = *objects = 0;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(Elf64_Ehdr)){
+        close(fd);
+        return -1;
+    }
+    unsigned char *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return -1;
+
+    int r = -1;
+    const Elf64_Ehdr *eh = (const Elf64_Ehdr *)data;
+    size_t size = st.st_size;
+    if (memcmp(eh->e_ident, ELFMAG, SELFMAG) == 0 && eh->e_ident[EI_CLASS] == ELFCLASS64 &&
+        eh->e_shoff + (size_t)eh->e_shnum * sizeof(Elf64_Shdr) <= size){
+        const Elf64_Shdr *sh = (const Elf64_Shdr *)(data + eh->e_shoff);
+        r = 0;
+        for (size_t i = 0; i < eh->e_shnum; i++){
+            if (sh[i].sh_type != SHT_DYNSYM || sh[i].sh_offset + sh[i].sh_size > size) continue;
+            const Elf64_Sym *sym = (const Elf64_Sym *)(data + sh[i].sh_offset);
+            size_t n = sh[i].sh_size / sizeof(Elf64_Sym);
+            for (size_t k = 1; k < n; k++){
+                int bind = ELF64_ST_BIND(sym[k].st_info), type = ELF64_ST_TYPE(sym[k].st_info);
+                int vis = ELF64_ST_VISIBILITY(sym[k].st_other);
+                if (sym[k].st_shndx == SHN_UNDEF || (bind != STB_GLOBAL && bind != STB_WEAK)) continue;
+                if (vis != STV_DEFAULT && vis != STV_PROTECTED) continue;
+                if (type == STT_FUNC || type == STT_GNU_IFUNC) (*functions)++;
+                else if (type == STT_OBJECT || type == STT_TLS) (*objects)++;
+            }
+        }
+    }
+    munmap(data, size);
+    return r;
+}
+
+// `[shared] libfoo.so: N functions, M variables exported`, after a successful build
+void shared_report_exports(const compiler_conf *cfg, const char *path){
+    if (!is_shared_build(cfg) || !cfg->shared_opt) return;
+    size_t functions, objects;
+    if (shared_count_exports(path, &functions, &objects) != 0) return;
+    printf("%s[shared]%s %s: %zu functions, %zu variables exported\n",
+           abs_fore.blue, abs_fore.normal, path, functions, objects);
+}
+
+#endif
+#define ABS_SHARED
@@ -0,0 +1,146 @@
+#include "abs/colors.h"
+#include "jobs.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+
+#ifndef ABS_STATS
+
+/*
+ * `abs --stats`. Phases add their wall time here whether or not the report
+ * is wanted, the clock reads are cheap next to the work they measure. Job
+ * CPU time and peak RSS come from the rusage wait4 returns for each job,
+ * which covers the compiler processes the job's shell waited for.
+ */
+
+#define ABS_STATS_TOP_JOBS 20
+
+typedef struct {
+    char   name[128];
+    double ms;
+    bool   ok;
+} stats_module;
+
+typedef struct {
+    bool   enabled;
+    double start_ms;
+    double ini_ms;          // reading and parsing the configuration
+    double glob_ms;         // expanding source, lib and directory lists
+    double scan_ms;         // stat, signature and header checks of objects
+    double plan_ms;         // building the job list, scan included
+    size_t compiled;
+    size_t up_to_date;
+
+    stats_module *modules;
+    size_t        modules_n;
+} build_stats;
+
+static __thread build_stats abs_stats;
+
+static double stats_now_ms(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+static void stats_module_done(const char *name, double ms, bool ok){
+    stats_module *tmp = realloc(abs_stats.modules, sizeof(stats_module) * (abs_stats.modules_n + 1));
+    if (!tmp) return;
+    abs_stats.modules = tmp;
+    stats_module *m = &abs_stats.modules[abs_stats.modules_n++];
+    snprintf(m->name, sizeof(m->name), "%s", name);
+    m->ms = ms;
+    m->ok = ok;
+}
+
+static double _stats_cpu_ms(const abs_job *j){
+    const struct rusage *ru = &j->usage;
+    return (ru->ru_utime.tv_sec + ru->ru_stime.tv_sec) * 1000.0 +
+           (ru->ru_utime.tv_usec + ru->ru_stime.tv_usec) / 1000.0;
+}
+
+static double _stats_ts_ms(const struct timespec *ts){
+    return ts->tv_sec * 1000.0 + ts->tv_nsec / 1e6;
+}
+
+static int _stats_by_wall(const void *a, const void *b){
+    const abs_job *ja = *(const abs_job *const *)a, *jb = *(const abs_job *const *)b;
+    long da = jobs_elapsed_ms(ja), db = jobs_elapsed_ms(jb);
+    return (da < db) - (da > db);
+}
+
+// `jl` may be NULL when the configuration only builds modules
+void stats_report(const job_list *jl, int parallel){
+    if (!abs_stats.enabled) return;
+    const char *c = abs_fore.blue, *n = abs_fore.normal;
+    double total = stats_now_ms() - abs_stats.start_ms;
+
+    printf("\n%s[stats]%s total %.1f ms\n", c, n, total);
+    printf("%s[stats]%s   config parse   %9.1f ms\n", c, n, abs_stats.ini_ms);
+    printf("%s[stats]%s   glob expansion %9.1f ms\n", c, n, abs_stats.glob_ms);
+    printf("%s[stats]%s   stat scanning  %9.1f ms\n", c, n, abs_stats.scan_ms);
+    printf("%s[stats]%s   other planning %9.1f ms\n", c, n,
+           abs_stats.plan_ms > abs_stats.scan_ms ? abs_stats.plan_ms - abs_stats.scan_ms : 0);
+    for (size_t i = 0; i < abs_stats.modules_n; i++){
+        const stats_module *m = &abs_stats.modules[i];
+        printf("%s[stats]%s   module %-7s %9.1f ms%s\n", c, n, m->name, m->ms, m->ok ? "" : " (failed)");
+    }
+    printf("%s[stats]%s   objects: %zu compiled, %zu up to date\n", c, n, abs_stats.compiled, abs_stats.up_to_date);
+
+    if (!jl || jl->n == 0) return;
+
+    double compile_cpu = 0, link_cpu = 0, link_wall = 0, first = 0, last = 0;
+    long max_rss = 0;
+    size_t ran = 0, failed = 0, skipped = 0;
+    const abs_job **order = malloc(sizeof(abs_job*) * jl->n);
+
+    for (size_t i = 0; i < jl->n; i++){
+        const abs_job *j = &jl->jobs[i];
+        if (j->state == JOB_SKIPPED) skipped++;
+        if (j->state != JOB_OK && j->state != JOB_FAILED) continue;
+        if (j->state == JOB_FAILED) failed++;
+        if (order) order[ran] = j;
+        ran++;
+
+        if (j->usage.ru_maxrss > max_rss) max_rss = j->usage.ru_maxrss;
+        if (j->kind == JOB_LINK){
+            link_cpu += _stats_cpu_ms(j);
+            link_wall += jobs_elapsed_ms(j);
+        } else if (j->kind == JOB_COMPILE){
+            compile_cpu += _stats_cpu_ms(j);
+            double s = _stats_ts_ms(&j->started), f = _stats_ts_ms(&j->finished);
+            if (first == 0 || s < first) first = s;
+            if (f > last) last = f;
+        }
+    }
+
+    double compile_wall = last - first;
+    if (compile_wall > 0){
+        double speedup = compile_cpu / compile_wall;
+        printf("%s[stats]%s   compile        %9.1f ms wall, %.1f ms cpu, %.2fx on -j%d (%.0f%% efficient)\n",
+               c, n, compile_wall, compile_cpu, speedup, parallel, speedup * 100.0 / (parallel > 0 ? parallel : 1));
+    }
+    if (link_wall > 0){
+        printf("%s[stats]%s   link           %9.1f ms wall, %.1f ms cpu\n", c, n, link_wall, link_cpu);
+    }
+    printf("%s[stats]%s   jobs: %zu ran, %zu failed, %zu skipped, peak RSS %.1f MiB\n",
+           c, n, ran, failed, skipped, max_rss / 1024.0);
+
+    if (!order) return;
+    qsort(order, ran, sizeof(abs_job*), _stats_by_wall);
+    size_t shown = ran < ABS_STATS_TOP_JOBS ? ran : ABS_STATS_TOP_JOBS;
+    printf("%s[stats]%s   %-7s %9s %9s %9s  %s\n", c, n, "job", "wall ms", "cpu ms", "rss MiB", "label");
+    for (size_t i = 0; i < shown; i++){
+        const abs_job *j = order[i];
+        printf("%s[stats]%s   %-7s %9ld %9.1f %9.1f  %s\n", c, n, jobs_kind_name(j->kind),
+               jobs_elapsed_ms(j), _stats_cpu_ms(j), j->usage.ru_maxrss / 1024.0, j->label);
+    }
+    if (ran > shown) printf("%s[stats]%s   ... %zu faster jobs not shown\n", c, n, ran - shown);
+    free(order);
+}
+
+#endif
+#define ABS_STATS
@@ -0,0 +1,271 @@
+#include "compilation.h"
+#include "jobs.h"
+#include <limits.h>
+
+#ifndef ABS_TESTS
+
+/*
+ * `abs test`. Test binaries listed in [tests] run in parallel once the
+ * build is done, longest first by their recorded durations. A test whose
+ * binary is byte-identical to the one that last passed is not run again.
+ *
+ * History and output logs live in the abs cache (abs_state_path) rather
+ * than the objects directory, which cleanup removes. The history has one
+ * line per test:
+ *   path <TAB> binary hash <TAB> duration ms <TAB> pass (0/1)
+ */
+
+typedef struct {
+    int  jobs;          // parallel tests, 0 for the number of cores
+    int  shard;         // 1-based index of this shard, 0 when not sharding
+    int  shards;
+    bool all;           // ignore history and rerun passing tests
+} test_opts;
+
+typedef struct {
+    char    *path;
+    uint64_t hash;
+    long     duration_ms;   // -1 when never run
+    bool     passed;
+} test_record;
+
+typedef struct {
+    test_record *records;
+    size_t       n;
+} test_history;
+
+static test_record *tests_find(test_history *h, const char *path){
+    for (size_t i = 0; i < h->n; i++){
+        if (strcmp(h->records[i].path, path) == 0) return &h->records[i];
+    }
+    return NULL;
+}
+
+static test_record *tests_record(test_history *h, const char *path){
+    test_record *r = tests_find(h, path);
+    if (r) return r;
+
+    test_record *tmp = realloc(h->records, sizeof(test_record) * (h->n + 1));
+    if (!tmp) return NULL;
+    h->records = tmp;
+    r = &h->records[h->n++];
+    memset(r, 0, sizeof(*r));
+    r->path = strdup(path);
+    r->duration_ms = -1;
+    return r;
+}
+
+static void tests_history_load(test_history *h, const char *file){
+    memset(h, 0, sizeof(*h));
+    FILE *f = fopen(file, "r");
+    if (!f) return;
+
+    char line[PATH_MAX + 128];
+    while (fgets(line, sizeof(line), f)){
+        line[strcspn(line, "\n")] = '\0';
+        char *tab = strchr(line, '\t');
+        if (!tab) continue;
+        *tab = '\0';
+
+        unsigned long long hash;
+        long duration;
+        int passed;
+        if (sscanf(tab + 1, "%llx\t%ld\t%d", &hash, &duration, &passed) != 3) continue;
+
+        test_record *r = tests_record(h, line);
+        if (!r) break;
+        r->hash = hash;
+        r->duration_ms = duration;
+        r->passed = passed != 0;
+    }
+    fclose(f);
+}
+
+static void tests_history_save(const test_history *h, const char *file){
+    char tmp[PATH_MAX + 8];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", file);
+
+    FILE *f = fopen(tmp, "w");
+    if (!f) return;
+    for (size_t i = 0; i < h->n; i++){
+        const test_record *r = &h->records[i];
+        fprintf(f, "%s\t%016llx\t%ld\t%d\n", r->path, (unsigned long long)r->hash,
+                r->duration_ms, r->passed ? 1 : 0);
+    }
+    if (fclose(f) == 0) rename(tmp, file);
+    else unlink(tmp);
+}
+
+static void tests_history_free(test_history *h){
+    for (size_t i = 0; i < h->n; i++) free(h->records[i].path);
+    free(h->records);
+    memset(h, 0, sizeof(*h));
+}
+
+// content hash, so a relink producing the same binary still counts as unchanged
+static int tests_hash_file(const char *path, uint64_t *out){
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)){
+        close(fd);
+        return -1;
+    }
+
+    *out = 0;
+    if (st.st_size > 0){
+        char *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED){
+            close(fd);
+            return -1;
+        }
+        *out = depscan_hash(data, st.st_size);
+        munmap(data, st.st_size);
+    }
+    close(fd);
+    return 0;
+}
+
+// shards split by name hash, so every machine agrees without shared history
+static bool tests_in_shard(const test_opts *opts, const char *path){
+    if (opts->shards <= 1) return true;
+    return depscan_hash(path, strlen(path)) % (uint64_t)opts->shards == (uint64_t)(opts->shard - 1);
+}
+
+static int _tests_by_duration(const void *a, const void *b, void *arg){
+    test_history *h = arg;
+    const char *pa = *(const char *const *)a, *pb = *(const char *const *)b;
+    test_record *ra = tests_find(h, pa), *rb = tests_find(h, pb);
+    // tests never timed go first, their duration is unknown
+    long da = ra && ra->duration_ms >= 0 ? ra->duration_ms : LONG_MAX;
+    long db = rb && rb->duration_ms >= 0 ? rb->duration_ms : LONG_MAX;
+    if (da != db) return da < db ? 1 : -1;
+    return strcmp(pa, pb);
+}
+
+typedef struct {
+    test_history *history;
+    uint64_t     *hashes;
+} _tests_run_ctx;
+
+static void _tests_on_event(const job_list *jl, size_t job, void *user){
+    const abs_job *j = &jl->jobs[job];
+    _tests_run_ctx *ctx = user;
+    if (j->kind != JOB_TEST) return;
+    if (j->state != JOB_OK && j->state != JOB_FAILED) return;
+
+    long ms = jobs_elapsed_ms(j);
+    bool ok = j->state == JOB_OK;
+    printf("%s[test]%s %s %s%s%s (%ld ms)\n", abs_fore.blue, abs_fore.normal, j->label,
+           ok ? abs_fore.green : abs_fore.red, ok ? "PASS" : "FAIL", abs_fore.normal, ms);
+    fflush(stdout);
+
+    test_record *r = tests_record(ctx->history, j->label);
+    if (!r) return;
+    r->duration_ms = ms;
+    r->passed = ok;
+    r->hash = ctx->hashes[job];
+}
+
+/*
+ * Runs the [tests] binaries of an already built config. Returns the
+ * number of failed tests, or -1 when there is nothing to run.
+ */
+int tests_run(ini_config *ini, const test_opts *opts){
+    const char *list = ini_get_at(ini, "tests", "binaries");
+    if (!list){
+        fprintf(stderr, "%s[error]%s no [tests] binaries configured\n", abs_fore.red, abs_fore.normal);
+        return -1;
+    }
+    const char *args = ini_get_at(ini, "tests", "args");
+    const char *timeout = ini_get_at(ini, "tests", "timeout");
+
+    char **paths = NULL;
+    size_t paths_n = 0;
+    expand_sources(NULL, list, &paths, &paths_n);
+
+    char *obj_dir = config_obj_dir(ini);
+    char history_path[PATH_MAX + 64], test_dir[PATH_MAX + 64];
+    bool have_history = abs_state_path(obj_dir, "tests", history_path, sizeof(history_path)) == 0;
+    if (abs_state_path(obj_dir, "test-logs", test_dir, sizeof(test_dir)) != 0){
+        snprintf(test_dir, sizeof(test_dir), "%s/tests", obj_dir);
+    }
+    free(obj_dir);
+    mkdir_p(test_dir);
+
+    test_history history;
+    if (have_history) tests_history_load(&history, history_path);
+    else memset(&history, 0, sizeof(history));
+
+    qsort_r(paths, paths_n, sizeof(char*), _tests_by_duration, &history);
+
+    job_list jobs;
+    jobs_init(&jobs);
+    uint64_t *hashes = calloc(paths_n ? paths_n : 1, sizeof(uint64_t));
+    size_t unchanged = 0, missing = 0, other_shard = 0;
+
+    for (size_t i = 0; i < paths_n; i++){
+        const char *path = paths[i];
+        if (!tests_in_shard(opts, path)){
+            other_shard++;
+            continue;
+        }
+
+        uint64_t hash;
+        if (tests_hash_file(path, &hash) != 0){
+            fprintf(stderr, "%s[test]%s %s: binary not found\n", abs_fore.red, abs_fore.normal, path);
+            missing++;
+            continue;
+        }
+
+        test_record *r = tests_find(&history, path);
+        if (!opts->all && r && r->passed && r->hash == hash){
+            printf("%s[skip]%s %s (unchanged since last pass)\n", abs_fore.cyan, abs_fore.normal, path);
+            unchanged++;
+            continue;
+        }
+
+        char cmd[PATH_MAX * 2 + 128], log_path[PATH_MAX * 2 + 96];
+        char flat[PATH_MAX];
+        snprintf(flat, sizeof(flat), "%s", path);
+        for (char *p = flat; *p; p++) if (*p == '/') *p = '_';
+        snprintf(log_path, sizeof(log_path), "%s/%s.log", test_dir, flat);
+        snprintf(cmd, sizeof(cmd), "%s%s%s\"%s%s\" %s",
+                 timeout ? "timeout " : "", timeout ? timeout : "", timeout ? " " : "",
+                 strchr(path, '/') ? "" : "./", path, args ? args : "");
+
+        long job = jobs_add(&jobs, JOB_TEST, path, cmd, log_path, NULL);
+        if (job >= 0) hashes[job] = hash;
+    }
+
+    int parallel = opts->jobs > 0 ? opts->jobs : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (opts->shards > 1){
+        printf("%s[test]%s shard %d/%d: %zu tests here, %zu in other shards\n", abs_fore.blue, abs_fore.normal,
+               opts->shard, opts->shards, jobs.n + unchanged + missing, other_shard);
+    }
+    printf("%s[test]%s running %zu tests, %d at a time\n", abs_fore.blue, abs_fore.normal, jobs.n, parallel);
+
+    _tests_run_ctx ctx = { &history, hashes };
+    jobs.quiet = true;
+    jobs.on_event = _tests_on_event;
+    jobs.user = &ctx;
+
+    int failed = jobs_run(&jobs, parallel, true);
+    jobs_summary(&jobs);
+    if (have_history) tests_history_save(&history, history_path);
+
+    printf("%s[test]%s %zu passed, %d failed, %zu unchanged%s\n", abs_fore.blue, abs_fore.normal,
+           jobs.n - failed, failed, unchanged, missing ? ", some binaries missing" : "");
+
+    jobs_free(&jobs);
+    free(hashes);
+    tests_history_free(&history);
+    for (size_t i = 0; i < paths_n; i++) free(paths[i]);
+    free(paths);
+
+    return failed + (int)missing;
+}
+
+#endif
+#define ABS_TESTS
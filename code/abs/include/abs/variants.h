@@ -0,0 +1,231 @@
+#include "configuration.h"
+#include "modules.h"
+#include <ctype.h>
+
+#ifndef ABS_VARIANTS
+
+/*
+ * Multi-ISA builds. Every [variants] source is compiled once without any
+ * -march (the `base` fallback) and once per listed level, with each listed
+ * symbol renamed to `<symbol>_<level>`. A generated dispatcher defines the
+ * original symbols as GNU ifuncs that pick the best variant at load time.
+ *
+ * The dispatcher is always C, whatever the compiler: the ifunc names its
+ * resolver by symbol, and C names carry no signature, so the symbols may
+ * have any prototype. C++ variant sources must therefore give them
+ * `extern "C"` linkage. Any other external symbol of a variant source is
+ * defined once per level and collides at link time; keep those static.
+ */
+
+// `x86-64-v3` -> `x86_64_v3`, usable as a symbol suffix and file prefix
+static void variant_suffix(const char *level, char *out, size_t out_sz){
+    size_t i = 0;
+    for (; level[i] && i + 1 < out_sz; i++){
+        out[i] = isalnum((unsigned char)level[i]) ? level[i] : '_';
+    }
+    out[i] = '\0';
+}
+
+static int is_variant_source(const compiler_conf *cfg, const char *src){
+    for (size_t i = 0; i < cfg->variant_sources_n; i++){
+        if (strcmp(cfg->variant_sources[i], src) == 0) return 1;
+    }
+    return 0;
+}
+
+static size_t build_variant_flags(const compiler_conf *cfg, const char *level,
+                                  char *out_buf, size_t out_sz, size_t pos){
+    char suffix[128];
+    variant_suffix(level ? level : "base", suffix, sizeof(suffix));
+
+    if (level) {
+        pos += snprintf(out_buf + pos, out_sz - pos, "-march=%s ", level);
+    }
+    for (size_t i = 0; i < cfg->variant_symbols_n; i++){
+        pos += snprintf(out_buf + pos, out_sz - pos, "-D%s=%s_%s ",
+                        cfg->variant_symbols[i], cfg->variant_symbols[i], suffix);
+    }
+    return pos;
+}
+
+static const char *_variants_skip_space(const char *p){
+    while (isspace((unsigned char)*p)) p++;
+    return p;
+}
+
+/*
+ * Marks in `linked` the symbols `src` names with C linkage: inside an
+ * `extern "C" { ... }` block, or in the declaration right after a plain
+ * `extern "C"`. `src` has its comments blanked.
+ */
+static void _variants_c_symbols(const compiler_conf *cfg, const char *src, bool *linked){
+    size_t depth = 0, blocks_n = 0, blocks[64];
+    bool decl = false, block_next = false;
+    for (const char *p = src; *p;){
+        if (*p == '"' || *p == '\''){
+            char quote = *p++;
+            while (*p && *p != quote) p += p[0] == '\\' && p[1] ? 2 : 1;
+            if (*p) p++;
+        } else if (source_ident(*p) && (p == src || !source_ident(p[-1]))){
+            const char *end = p;
+            while (source_ident(*end)) end++;
+            size_t len = end - p;
+            const char *next = _variants_skip_space(end);
+            if (len == 6 && memcmp(p, "extern", 6) == 0 && strncmp(next, "\"C\"", 3) == 0){
+                next = _variants_skip_space(next + 3);
+                if (*next == '{') block_next = true;
+                else decl = true;
+                end = next;
+            } else if (decl || blocks_n){
+                for (size_t s = 0; s < cfg->variant_symbols_n; s++){
+                    const char *sym = cfg->variant_symbols[s];
+                    if (strlen(sym) == len && memcmp(sym, p, len) == 0) linked[s] = true;
+                }
+            }
+            p = end;
+        } else {
+            if (*p == '{'){
+                if (block_next && blocks_n < sizeof(blocks) / sizeof(blocks[0])) blocks[blocks_n++] = depth;
+                block_next = decl = false;
+                depth++;
+            } else if (*p == '}' && depth){
+                depth--;
+                if (blocks_n && blocks[blocks_n - 1] == depth) blocks_n--;
+            } else if (*p == ';'){
+                decl = false;
+            }
+            p++;
+        }
+    }
+}
+
+/*
+ * A C++ variant source has to declare the symbols `extern "C"`, or the
+ * variants get mangled names the C dispatcher cannot refer to. Every
+ * listed symbol the source mentions must appear with C linkage there.
+ */
+static int variants_check_linkage(const compiler_conf *cfg){
+    bool *linked = calloc(cfg->variant_symbols_n ? cfg->variant_symbols_n : 1, sizeof(bool));
+    int r = linked ? 0 : -1;
+    for (size_t i = 0; r == 0 && i < cfg->variant_sources_n; i++){
+        char path[PATH_MAX];
+        snprintf(path, sizeof(path), "%s/%s", cfg->src_dir, cfg->variant_sources[i]);
+        if (!is_cxx_source(path)) continue;
+
+        size_t len = 0;
+        char *data = NULL;
+        FILE *f = fopen(path, "r");
+        if (f){
+            struct stat st;
+            if (fstat(fileno(f), &st) == 0 && (data = malloc(st.st_size + 1))){
+                len = fread(data, 1, st.st_size, f);
+                data[len] = '\0';
+            }
+            fclose(f);
+        }
+        if (!data) continue;
+        source_blank_comments(data, false);
+        memset(linked, 0, cfg->variant_symbols_n * sizeof(bool));
+        _variants_c_symbols(cfg, data, linked);
+
+        for (size_t s = 0; s < cfg->variant_symbols_n; s++){
+            const char *sym = cfg->variant_symbols[s], *hit = data;
+            size_t sym_len = strlen(sym);
+            bool mentioned = false;
+            while (!mentioned && (hit = strstr(hit, sym))){
+                mentioned = (hit == data || !source_ident(hit[-1])) && !source_ident(hit[sym_len]);
+                hit += sym_len;
+            }
+            if (mentioned && !linked[s]){
+                fprintf(stderr, "%s[error]%s [variants] %s: %s is not extern \"C\", the generated "
+                        "dispatcher cannot refer to it\n", abs_fore.red, abs_fore.normal,
+                        cfg->variant_sources[i], sym);
+                r = -1;
+            }
+        }
+        free(data);
+    }
+    free(linked);
+    return r;
+}
+
+/*
+ * The dispatcher is C, so of the configuration's flags it keeps the
+ * target ones (-m...), which must match the variants' ABI; C++-only
+ * flags like -std=c++20 would only warn. Defines and include dirs stay.
+ * Free `out->cflags` (the array only) when done.
+ */
+static int variants_dispatcher_conf(const compiler_conf *cfg, compiler_conf *out){
+    *out = *cfg;
+    out->cflags = malloc(sizeof(char*) * (cfg->cflags_n ? cfg->cflags_n : 1));
+    out->cflags_n = 0;
+    if (!out->cflags) return -1;
+    for (size_t i = 0; i < cfg->cflags_n; i++){
+        if (strncmp(cfg->cflags[i], "-m", 2) == 0) out->cflags[out->cflags_n++] = cfg->cflags[i];
+    }
+    return 0;
+}
+
+/*
+ * Levels are checked from the last listed to the first, so list them from
+ * the oldest to the newest ISA. x86-64-vN levels use __builtin_cpu_supports,
+ * anything else (e.g. `haswell`) is matched with __builtin_cpu_is.
+ */
+static size_t variants_dispatcher_source(const compiler_conf *cfg, char *out, size_t out_sz){
+    size_t pos = 0;
+    pos += snprintf(out + pos, out_sz - pos, "/* generated by abs from [variants], do not edit */\n\n");
+
+    for (size_t s = 0; s < cfg->variant_symbols_n; s++){
+        const char *sym = cfg->variant_symbols[s];
+
+        pos += snprintf(out + pos, out_sz - pos, "extern void %s_base(void);\n", sym);
+        for (size_t l = 0; l < cfg->variant_levels_n; l++){
+            char suffix[128];
+            variant_suffix(cfg->variant_levels[l], suffix, sizeof(suffix));
+            pos += snprintf(out + pos, out_sz - pos, "extern void %s_%s(void);\n", sym, suffix);
+        }
+
+        pos += snprintf(out + pos, out_sz - pos,
+                        "\nstatic void *abs_resolve_%s(void){\n"
+                        "    __builtin_cpu_init();\n", sym);
+        for (size_t l = cfg->variant_levels_n; l-- > 0; ){
+            const char *level = cfg->variant_levels[l];
+            char suffix[128];
+            variant_suffix(level, suffix, sizeof(suffix));
+            pos += snprintf(out + pos, out_sz - pos,
+                            "    if (__builtin_cpu_%s(\"%s\")) return (void *)%s_%s;\n",
+                            strncmp(level, "x86-64-v", 8) == 0 ? "supports" : "is",
+                            level, sym, suffix);
+        }
+        pos += snprintf(out + pos, out_sz - pos,
+                        "    return (void *)%s_base;\n"
+                        "}\n"
+                        "void %s(void) __attribute__((ifunc(\"abs_resolve_%s\")));\n\n",
+                        sym, sym, sym);
+    }
+    return pos;
+}
+
+// rewrites the dispatcher only when its content changes, keeping mtime stable
+int variants_write_dispatcher(const compiler_conf *cfg, const char *path){
+    char content[16384];
+    size_t len = variants_dispatcher_source(cfg, content, sizeof(content));
+    if (len >= sizeof(content)) return -1;
+
+    FILE *f = fopen(path, "r");
+    if (f){
+        char old[16384];
+        size_t old_len = fread(old, 1, sizeof(old), f);
+        fclose(f);
+        if (old_len == len && memcmp(old, content, len) == 0) return 0;
+    }
+
+    f = fopen(path, "w");
+    if (!f) return -1;
+    fwrite(content, 1, len, f);
+    fclose(f);
+    return 0;
+}
+
+#endif
+#define ABS_VARIANTS
@@ -0,0 +1,318 @@
+#include "abs/colors.h"
+#include <abs/compilation.h>
+#include <abs/configuration.h>
+#include <abs/libabs.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+/*
+ * libabs, the in-process build API. Built from the same headers as the
+ * abs executable; everything but the ABS_API functions is hidden.
+ */
+
+struct abs_ctx {
+	char confpath[PATH_MAX];
+	char config_dir[PATH_MAX];
+	char cwd[PATH_MAX];
+
+	ini_config    ini;
+	compiler_conf cfg;
+	bool loaded;
+	bool has_files;
+
+	char output_path[PATH_MAX];
+	char **modules;
+	size_t modules_n;
+	abs_target_info target;
+
+	char error[512];
+};
+
+static void _abs_set_error(abs_ctx *ctx, const char *msg){
+	snprintf(ctx->error, sizeof(ctx->error), "%s", msg);
+}
+
+// config paths resolve against the cwd at load time, not at build time
+static void _abs_absolute(const abs_ctx *ctx, char **path){
+	if (!*path || (*path)[0] == '/') return;
+
+	size_t len = strlen(ctx->cwd) + strlen(*path) + 2;
+	char *abs_path = malloc(len);
+	if (!abs_path) return;
+	snprintf(abs_path, len, "%s/%s", ctx->cwd, *path);
+	free(*path);
+	*path = abs_path;
+}
+
+static void _abs_unload(abs_ctx *ctx){
+	if (!ctx->loaded) return;
+
+	// the objects directory is removed after builds, never on unload
+	ctx->cfg.cleanup = false;
+	compiler_conf_free(&ctx->cfg);
+	ini_clear_config(&ctx->ini);
+	for (size_t i = 0; i < ctx->modules_n; i++) free(ctx->modules[i]);
+	free(ctx->modules);
+	ctx->modules = NULL;
+	ctx->modules_n = 0;
+	ctx->loaded = false;
+}
+
+static int _abs_load(abs_ctx *ctx){
+	_abs_unload(ctx);
+	memset(&ctx->cfg, 0, sizeof(ctx->cfg));
+	memset(&ctx->target, 0, sizeof(ctx->target));
+
+	if (0 > ini_load_file(&ctx->ini, ctx->confpath)){
+		_abs_set_error(ctx, "failed to load configuration");
+		return -1;
+	}
+	ctx->loaded = true;
+
+	ctx->has_files = ini_check(&ctx->ini, "files") == 0;
+	if (ctx->has_files && config_ini_parse(&ctx->ini, &ctx->cfg) != 0){
+		_abs_set_error(ctx, abs_config_error);
+		return -1;
+	}
+
+	if (ctx->has_files){
+		compiler_conf *cfg = &ctx->cfg;
+		_abs_absolute(ctx, &cfg->src_dir);
+		_abs_absolute(ctx, &cfg->out_dir);
+		_abs_absolute(ctx, &cfg->obj_dir);
+		_abs_absolute(ctx, &cfg->pkg_config_path);
+		for (size_t i = 0; i < cfg->include_n; i++) _abs_absolute(ctx, &cfg->include_dirs[i]);
+		for (size_t i = 0; i < cfg->lib_dirs_n; i++) _abs_absolute(ctx, &cfg->lib_dirs[i]);
+
+		config_set_root(cfg, ctx->config_dir);
+		get_output_path(cfg, ctx->output_path, sizeof(ctx->output_path));
+		ctx->target.output = ctx->output_path;
+		ctx->target.build_type = cfg->build_type;
+		ctx->target.sources = (const char *const *)cfg->sources;
+		ctx->target.sources_n = cfg->sources_n;
+	}
+
+	ini_iterator it = ini_iterator_init(&ctx->ini);
+	for (ini_iter i = ini_iterate(&it); i.sec_name != NULL; i = ini_iterate(&it)){
+		if (strcmp(i.sec_name, "modules") != 0) continue;
+		char **tmp = realloc(ctx->modules, sizeof(char*) * (ctx->modules_n + 1));
+		if (!tmp) break;
+		ctx->modules = tmp;
+		ctx->modules[ctx->modules_n++] = strdup(i.key);
+	}
+
+	ctx->target.name = ini_get_at(&ctx->ini, "project", "name");
+	ctx->target.version = ini_get_at(&ctx->ini, "project", "version");
+	ctx->target.modules = (const char *const *)ctx->modules;
+	ctx->target.modules_n = ctx->modules_n;
+	ctx->error[0] = '\0';
+	return 0;
+}
+
+ABS_API abs_ctx *abs_open(const char *confpath, char *err, size_t err_sz){
+	abs_ctx *ctx = calloc(1, sizeof(abs_ctx));
+	if (!ctx){
+		if (err) snprintf(err, err_sz, "out of memory");
+		return NULL;
+	}
+
+	char *dir = get_dir_from_path(confpath);
+	if (!getcwd(ctx->cwd, sizeof(ctx->cwd)) || !realpath(confpath, ctx->confpath) ||
+	    !dir || !realpath(dir, ctx->config_dir)){
+		if (err) snprintf(err, err_sz, "configuration not found: %s", confpath);
+		free(dir);
+		free(ctx);
+		return NULL;
+	}
+	free(dir);
+
+	if (_abs_load(ctx) != 0){
+		if (err) snprintf(err, err_sz, "%s", ctx->error);
+		_abs_unload(ctx);
+		free(ctx);
+		return NULL;
+	}
+	return ctx;
+}
+
+ABS_API void abs_close(abs_ctx *ctx){
+	if (!ctx) return;
+	_abs_unload(ctx);
+	free(ctx);
+}
+
+ABS_API int abs_reload(abs_ctx *ctx){
+	return _abs_load(ctx);
+}
+
+ABS_API const char *abs_error(const abs_ctx *ctx){
+	return ctx->error;
+}
+
+ABS_API const abs_target_info *abs_target(const abs_ctx *ctx){
+	return &ctx->target;
+}
+
+static char *_abs_read_log(const char *path){
+	if (!path) return NULL;
+	FILE *f = fopen(path, "r");
+	if (!f) return NULL;
+
+	size_t len = 0, cap = 4096;
+	char *buf = malloc(cap);
+	size_t r;
+	while (buf && (r = fread(buf + len, 1, cap - len - 1, f)) > 0){
+		len += r;
+		if (cap - len - 1 == 0){
+			char *tmp = realloc(buf, cap * 2);
+			if (!tmp){
+				free(buf);
+				buf = NULL;
+				break;
+			}
+			buf = tmp;
+			cap *= 2;
+		}
+	}
+	fclose(f);
+	if (buf) buf[len] = '\0';
+	return buf;
+}
+
+static void _abs_fill_job(abs_job_info *info, const abs_job *j){
+	info->kind = j->kind == JOB_LINK ? ABS_JOB_LINK : j->kind == JOB_GENERATE ? ABS_JOB_GENERATE : ABS_JOB_COMPILE;
+	info->state = (abs_job_state)j->state;
+	info->exit_status = (j->state == JOB_OK || j->state == JOB_FAILED) && WIFEXITED(j->status)
+	                  ? WEXITSTATUS(j->status) : -1;
+}
+
+static int _abs_result_init(abs_result *out, const job_list *jl){
+	memset(out, 0, sizeof(*out));
+	out->jobs = calloc(jl->n ? jl->n : 1, sizeof(abs_job_info));
+	if (!out->jobs) return -1;
+	out->jobs_n = jl->n;
+
+	for (size_t i = 0; i < jl->n; i++){
+		const abs_job *j = &jl->jobs[i];
+		out->jobs[i].label = strdup(j->label ? j->label : "");
+		out->jobs[i].command = strdup(j->cmd ? j->cmd : "");
+		out->jobs[i].output = NULL;
+		_abs_fill_job(&out->jobs[i], j);
+	}
+	return 0;
+}
+
+// plans the jobs of the target itself; modules are separate abs processes
+static int _abs_emit(abs_ctx *ctx, const abs_build_options *opts, job_list *jobs){
+	jobs_init(jobs);
+	jobs->quiet = true;
+	jobs_setenv(jobs, "MAIN_DIR", getenv("MAIN_DIR"));
+
+	if (!ctx->has_files) return 0;
+	// this process is not abs; without one, restat and remote compiles are off
+	ctx->cfg.self_path = opts && opts->abs_path ? opts->abs_path : "";
+	if (build_config_emit_jobs(opts && opts->force, &ctx->cfg, jobs) != 0){
+		_abs_set_error(ctx, "failed to plan the build");
+		jobs_free(jobs);
+		return -1;
+	}
+	return 0;
+}
+
+ABS_API int abs_plan(abs_ctx *ctx, const abs_build_options *opts, abs_result *out){
+	job_list jobs;
+	ctx->cfg.dry_run = true;
+	int planned = _abs_emit(ctx, opts, &jobs);
+	ctx->cfg.dry_run = false;
+	if (planned != 0) return -1;
+
+	int r = _abs_result_init(out, &jobs);
+	jobs_free(&jobs);
+	if (r != 0) _abs_set_error(ctx, "out of memory");
+	return r;
+}
+
+typedef struct {
+	abs_result     *res;
+	abs_progress_fn progress;
+	void           *user;
+	size_t          finished;
+} _abs_progress;
+
+static void _abs_on_job(const job_list *jl, size_t job, void *user){
+	_abs_progress *p = user;
+	const abs_job *j = &jl->jobs[job];
+	abs_job_info *info = &p->res->jobs[job];
+
+	_abs_fill_job(info, j);
+	if (j->state == JOB_OK || j->state == JOB_FAILED){
+		free((char*)info->output);
+		info->output = _abs_read_log(j->log_path);
+	}
+	if (j->state != JOB_RUNNING) p->finished++;
+
+	if (p->progress) p->progress(info, p->finished, jl->n, p->user);
+}
+
+ABS_API int abs_build(abs_ctx *ctx, const abs_build_options *opts,
+                      abs_progress_fn progress, void *user, abs_result *out){
+	abs_build_options defaults = {0};
+	if (!opts) opts = &defaults;
+
+	memset(out, 0, sizeof(*out));
+	build_opts bopts = { .force_recompile = opts->force, .keep_going = opts->keep_going != 0 };
+
+	size_t modules_failed = build_modules(opts->abs_path ? opts->abs_path : "abs",
+	                                      ctx->config_dir, &ctx->ini, &bopts);
+	if (modules_failed && !opts->keep_going){
+		out->modules_failed = modules_failed;
+		_abs_set_error(ctx, "module build failed");
+		return -1;
+	}
+
+	job_list jobs;
+	if (_abs_emit(ctx, opts, &jobs) != 0) return -1;
+	if (_abs_result_init(out, &jobs) != 0){
+		jobs_free(&jobs);
+		_abs_set_error(ctx, "out of memory");
+		return -1;
+	}
+	out->modules_failed = modules_failed;
+
+	for (size_t i = 0; modules_failed && i < jobs.n; i++){
+		if (jobs.jobs[i].kind == JOB_LINK) jobs.jobs[i].state = JOB_SKIPPED;
+	}
+
+	_abs_progress p = { out, progress, user, 0 };
+	jobs.on_event = _abs_on_job;
+	jobs.user = &p;
+
+	int parallel = opts->jobs > 0 ? opts->jobs : (ctx->has_files ? ctx->cfg.jobs : 1);
+	out->failed = jobs_run(&jobs, parallel, opts->keep_going != 0);
+	for (size_t i = 0; i < jobs.n; i++){
+		_abs_fill_job(&out->jobs[i], &jobs.jobs[i]);
+		if (jobs.jobs[i].state == JOB_SKIPPED) out->skipped++;
+	}
+	jobs_free(&jobs);
+
+	if (ctx->has_files && ctx->cfg.cleanup) cleanup_objects(&ctx->cfg);
+
+	if (out->failed || out->modules_failed){
+		_abs_set_error(ctx, "build failed");
+		return -1;
+	}
+	ctx->error[0] = '\0';
+	return 0;
+}
+
+ABS_API void abs_result_free(abs_result *res){
+	if (!res) return;
+	for (size_t i = 0; i < res->jobs_n; i++){
+		free((char*)res->jobs[i].label);
+		free((char*)res->jobs[i].command);
+		free((char*)res->jobs[i].output);
+	}
+	free(res->jobs);
+	memset(res, 0, sizeof(*res));
+}
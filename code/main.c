@@ -1,18 +1,55 @@
 #include "abs/colors.h"
 #include <abs/compilation.h>
 #include <abs/configuration.h>
+#include <abs/server.h>
+#include <abs/tests.h>
+#include <abs/bench.h>
+#include <abs/install.h>
+#include <abs/profile.h>
+#include <abs/ninja.h>
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
 
 void usage(const char *prog){
 	printf(
-		"usage: %s [-r] [PATH] [-h/--help] [gen]"
+		"usage: %s [-r] [-k] [-j N] [-n] [--explain] [--stats] [--modes A,B] [--progress MODE] [--profile-compile] [--emit-ninja] [--server] [PATH] [-h/--help] [gen] [test] [bench] [install]"
 		"\n\n-r - force rebuild project\n"
+		"-k/--keep-going - keep building independent files and modules\n"
+		"  after a failure, then print a summary of all failures\n"
+		"--server - run a build server for PATH in the foreground; later\n"
+		"  builds from the same directory are answered by it\n"
+		"--stop-server - stop the build server for PATH\n"
+		"--no-server - build locally even when a server is running\n"
+		"-j N - run at most N jobs at once\n"
+		"-n/--dry-run - plan the build and print it without running anything\n"
+		"--explain - give the reason of every compile and link\n"
+		"--stats - print phase timings, CPU time and peak RSS of every job\n"
+		"--modes A,B,... - build several [mode.*] configurations at once\n"
+		"  on one job pool, into OUTPUT/MODE with objects in OBJECTS/MODE\n"
+		"--profile-compile - rebuild every object with -ftime-trace (clang)\n"
+		"  or -ftime-report (gcc) and print the slowest translation units,\n"
+		"  headers by parse time and template instantiations (clang) or\n"
+		"  compiler passes (gcc), summed over the build\n"
+		"--emit-ninja - write build.ninja for PATH and its modules instead\n"
+		"  of building; it regenerates itself when an abs.conf changes.\n"
+		"  Takes --modes, -j N sets the depth of its link pool (1)\n"
+		"--progress MODE - how jobs are reported: status (one line redrawn\n"
+		"  in place, with an ETA from recorded durations), lines (one line\n"
+		"  per finished job), plain (job output only) or auto, the default:\n"
+		"  status on a terminal, lines otherwise\n"
 		"PATH - path to configuration, by default 'abs.conf'\n"
 		"-h/--help - show this message and exit\n"
 		"-d/--docs - show more help about configuration\n"
-		"gen - generate default config in current directory\n", prog);
+		"gen - generate default config in current directory\n"
+		"test - build, then run the [tests] binaries; takes -j N,\n"
+		"  --shard I/N (run the I-th of N slices) and --all (also rerun\n"
+		"  tests whose binary did not change since they last passed)\n"
+		"bench - build in release mode, then run the [bench] binaries and\n"
+		"  compare with the saved baseline; takes --save-baseline and\n"
+		"  --baseline FILE\n"
+		"install - build, then copy the [install] artifacts whose content\n"
+		"  changed under the prefix ($DESTDIR is prepended)\n", prog);
 	exit(EXIT_SUCCESS);
 }
 
@@ -47,14 +84,23 @@ void docs(){
 "- project:      name and version of the project\n"
 "- modules:      list of submodules to build before\n"
 "- compiler:     which compiler to use\n"
-"- modes:        sets active build mode (debug/release)\n"
+"- modes:        sets active build mode (debug/release/NAME)\n"
 "- dependencies: set of PKG config libs and static/dynamic libs\n"
 "- defines:      NAME=VALUE list for defines in program\n"
 "- flags:        common and security flags for building\n"
+"- flags.per_source: extra flags for sources matching a glob\n"
+"- variants:     sources built per ISA level with runtime dispatch\n"
+"- executor:     remote compile workers\n"
+"- tests:        test binaries run by `abs test`\n"
+"- bench:        benchmark binaries run by `abs bench`\n"
+"- install:      where `abs install` copies artifacts\n"
+"- shared:       symbols a shared library exports\n"
+"- generate.NAME: a code generation step, e.g. generate.proto\n"
 "- files:        source files and output file\n"
 "- dirs:         directories for source, output, include and lib files\n"
 "- mode.debug:   flags and security options on debug mode\n"
 "- mode.release: flags and security options on release mode\n"
+"- mode.NAME:    any other mode, e.g. mode.asan\n"
 "\n"
 "Per-section documentation\n"
 "PROJECT\n"
@@ -68,12 +114,44 @@ void docs(){
 "           (link - compile *.o files in objs dir, compile -\n"
 "           generate *.o files)\n"
 "- cleanup: clean objs directory or not (default: true)\n"
+"- linker:  auto, mold, lld, gold or default - linker used by\n"
+"           binary and shared links (auto picks the first one\n"
+"           the compiler accepts)\n"
+"- debuginfo: split (-gsplit-dwarf, .dwo files next to objects)\n"
+"           or compressed (-gz); applies when -g is set\n"
+"- dwp:     package .dwo files into OUTPUT.dwp (default: false)\n"
+"- thin_archive: static build references objects in place\n"
+"           (ar T) instead of copying them; keeps the objects\n"
+"           directory (default: false)\n"
+"- reproducible: bit-identical outputs across checkouts and\n"
+"           machines: maps the project directory to `.` in debug\n"
+"           info and __FILE__, sets SOURCE_DATE_EPOCH (0 unless\n"
+"           already set) and writes deterministic archives\n"
+"           (default: false)\n"
+"- restat:  keep a recompiled object or relinked output whose\n"
+"           bytes did not change, with its old timestamp, so\n"
+"           links and parent modules depending on it are skipped\n"
+"           (default: true)\n"
+"- shared_opt: load-time options of shared builds, `true` or some\n"
+"           of visibility (-fvisibility=hidden), symbolic\n"
+"           (-Bsymbolic-functions, -fno-semantic-interposition),\n"
+"           gnu-hash, as-needed, now (-z now), relro (-z relro)\n"
+"           (default: false)\n"
 "\n"
 "FLAGS\n"
 "- common: list[str], space-splitted enumeration of flags\n"
 "  which are used in all modes\n"
 "- hardening: list[str], enumeration of flags, which are \n"
 "  used when security is enabled\n"
+"- optional: list[str], flags that are used only if the compiler\n"
+"  accepts them (probed once per compiler, cached in\n"
+"  ~/.cache/abs/probes)\n"
+"\n"
+"FLAGS.PER_SOURCE\n"
+"- list of elements like `GLOB = FLAGS`; every source matching GLOB\n"
+"  gets FLAGS appended after the common and mode flags. Globs\n"
+"  without '/' are matched against the file name only. Changing\n"
+"  an override rebuilds only the sources it matches\n"
 "\n"
 "FILES\n"
 "- sources: enumeration (globs enabled) of all *.c files,\n"
@@ -86,10 +164,13 @@ void docs(){
 "- includes: directory where header files stored\n"
 "- libs:     directory where library files stored\n"
 "- objects:  directory where *.o files are stored\n"
+"  output/src/objects expand `$VAR` and `${VAR}`, e.g. `$MAIN_DIR/bin`\n"
 "\n"
 "MODES\n"
-"- active: active `debug` or `release`, changes mode.debug/release\n"
-"  choice\n"
+"- active: active mode, `debug` (default), `release` or any NAME\n"
+"  with a [mode.NAME] section; the ABS_MODE environment variable\n"
+"  overrides it. `abs --modes debug,release,asan` builds several\n"
+"  at once; modules are still built once, in their own mode\n"
 "\n"
 "DEPENDENCIES\n"
 "- pkgs_path: PKG_CONFIG_PATH variable\n"
@@ -98,17 +179,92 @@ void docs(){
 "\n"
 "MODE.DEBUG\n"
 "- flags: additional flags when building in debug mode\n"
+"- optional: probed flags used only in debug mode\n"
 "- security: bool, `true` or `false`, enables harderning flags\n"
 "   if set to true\n"
 "\n"
 "MODE.RELEASE\n"
 "- flags: additional flags when building in release mode\n"
+"- optional: probed flags used only in release mode\n"
 "- security: bool, `true` or `false`, enables harderning flags\n"
 "   if set to true\n"
+"\n"
+"MODE.NAME\n"
+"- same keys as mode.debug, for a mode of your own, e.g.\n"
+"  [mode.asan] flags = -g -fsanitize=address\n"
 "DEFINES\n"
 "- list of elements like `KEY = VALUE` that are passed to program\n"
 "  in -D...=... format\n"
 "\n"
+"VARIANTS\n"
+"- sources: enumeration (globs enabled) of sources built once per\n"
+"  level; do not list them in files.sources\n"
+"- levels:  -march values from oldest to newest (x86-64-v2 ...)\n"
+"- symbols: functions defined in those sources; each is renamed\n"
+"  to SYMBOL_LEVEL and a generated ifunc dispatcher picks the\n"
+"  best variant at startup, falling back to a -march-less build.\n"
+"  The dispatcher is compiled as C: in C++ sources the symbols\n"
+"  must be extern \"C\". Other external symbols of these sources\n"
+"  are defined once per level and collide at link, keep them static\n"
+"\n"
+"TESTS\n"
+"- binaries: enumeration (globs enabled) of test executables,\n"
+"  including ones built by modules\n"
+"- args:     arguments passed to every test\n"
+"- timeout:  seconds before a test is killed (needs `timeout`)\n"
+"  durations and results are kept in ~/.cache/abs/state\n"
+"\n"
+"BENCH\n"
+"- binaries:    enumeration (globs enabled) of benchmark executables\n"
+"- args:        arguments passed to every benchmark\n"
+"- repetitions: measured runs per benchmark, 10 by default\n"
+"- warmup:      discarded runs before measuring, 1 by default\n"
+"- cpu:         pin benchmarks to this CPU number\n"
+"- threshold:   median slowdown in percent that fails `abs bench`,\n"
+"  5 by default; the slowdown must also exceed the run-to-run noise\n"
+"  results go to OBJECTS/bench/results.json, the baseline compared\n"
+"  against to OBJECTS/bench/baseline.json\n"
+"\n"
+"INSTALL\n"
+"- prefix:  destination directory, `$VAR` expanded; $DESTDIR is\n"
+"  prepended for staging\n"
+"- bin:     enumeration (globs enabled) of files for PREFIX/bin\n"
+"- lib:     same for PREFIX/lib; symlinks stay symlinks, so\n"
+"  `lib/libfoo.so*` installs the whole version chain\n"
+"- include: same for PREFIX/include\n"
+"  without bin, lib and include the build output is installed.\n"
+"  Unchanged files are skipped, others are reflinked or copied\n"
+"  in the kernel to a temporary file renamed over the old one\n"
+"\n"
+"SHARED\n"
+"- exports: symbol names or globs the library exports; everything\n"
+"  else becomes local through a generated version script\n"
+"- headers: enumeration (globs enabled) of headers whose MACRO\n"
+"  declarations are exported; MACRO is defined to default\n"
+"  visibility while compiling, headers define it empty otherwise.\n"
+"  With headers, names in `exports` must be marked too, as\n"
+"  sources are compiled with hidden visibility\n"
+"- macro:   export marker in headers, ABS_EXPORT by default\n"
+"  needs shared_opt; the build reports how many symbols are exported.\n"
+"  For C++ sources or compilers, names also match demangled symbols,\n"
+"  unqualified or in any scope, like `name` or `ns::name(int)`\n"
+"\n"
+"GENERATE.NAME\n"
+"- command: shell command run from the configuration directory\n"
+"- inputs:  enumeration (globs enabled) of files it reads\n"
+"- outputs: files it writes; generated sources under dirs.src are\n"
+"  compiled, other outputs (headers) are dependencies only\n"
+"  the command runs when an output is missing, an input is newer\n"
+"  or the command changed, in parallel with compiles that do not\n"
+"  need it; objects built from what it regenerates are recompiled\n"
+"\n"
+"EXECUTOR\n"
+"- workers: endpoints of abs-worker processes, `unix:PATH`,\n"
+"  `tcp:PORT` or `tcp:HOST:PORT`; sources are preprocessed here\n"
+"  and compiled remotely, falling back to local compiles when no\n"
+"  worker answers (modules and split debug info stay local)\n"
+"- jobs:    parallel compile jobs (default: 2 per worker, else 1)\n"
+"\n"
 "MODULES\n"
 "- list of elements like `MODULE_NAME = MODULE_DIR, MODULE_CONFIG`\n"
 "  for example\n"
@@ -122,7 +278,8 @@ void docs(){
 	printf("Documentation:\n%s\n", docs_str);
 }
 
-int build(const char *prog, const char *confpath, int force_recompile){
+// builds an already loaded configuration; used directly by the build server
+int build_loaded(const char *prog, const char *confpath, ini_config *conf, const build_opts *opts){
 	char *config_dir = get_dir_from_path(confpath);
 	if (!config_dir) {
         fprintf(stderr, "%sfailed%s to determine config directory\n", abs_fore.red, abs_fore.normal);
@@ -133,15 +290,9 @@ int build(const char *prog, const char *confpath, int force_recompile){
 	realpath(config_dir, resolved);
 	free(config_dir);
 
-	ini_config conf;
-	if (0 > ini_load_file(&conf, confpath)){
-		fprintf(stderr, "%sfailed%s to load configuration: %s%s%s\naborting\n", abs_fore.red, abs_fore.normal, abs_fore.gray, confpath, abs_fore.normal);
-		return -1;
-	}
-
 	char *MAIN_DIR = getenv("MAIN_DIR");
-	const char *prj_name = ini_get_at(&conf, "project", "name");
-	const char *prj_ver = ini_get_at(&conf, "project", "version");
+	const char *prj_name = ini_get_at(conf, "project", "name");
+	const char *prj_ver = ini_get_at(conf, "project", "version");
 	if (!MAIN_DIR && prj_name){
 		printf("Building project %s%s%s\n", abs_fore.yellow, prj_name, abs_fore.normal);
 	}
@@ -149,77 +300,283 @@ int build(const char *prog, const char *confpath, int force_recompile){
 		printf("Version %s%s%s\n", abs_fore.blue, prj_ver, abs_fore.normal);
 	}
 
-	build_modules(prog, resolved, &conf, force_recompile);
+	int modules_failed = build_modules(prog, resolved, conf, opts);
+	int failed = 0;
+	if (modules_failed && !opts->keep_going){
+		exit(-1);
+	}
 
 	// no files
-	if (ini_check(&conf, "files")){
+	if (ini_check(conf, "files")){
+		stats_report(NULL, 0);
 		goto _end;
 	}
 
 	compiler_conf cconf;
 	memset(&cconf, 0, sizeof(cconf));
-	config_ini_parse(&conf, &cconf);
+	double parse_started = stats_now_ms(), glob_before = abs_stats.glob_ms;
+	if (0 != config_ini_parse(conf, &cconf)){
+		exit(-1);
+	}
+	abs_stats.ini_ms += stats_now_ms() - parse_started - (abs_stats.glob_ms - glob_before);
+	config_set_root(&cconf, resolved);
+	cconf.explain = opts->explain;
+	cconf.dry_run = opts->dry_run;
+	cconf.progress = opts->progress != JOBS_OUTPUT_PLAIN;
+	cconf.profile = opts->profile;
+	// a dry run must not delete the objects it just judged up to date
+	if (opts->dry_run) cconf.cleanup = false;
 
-	char cmd[15000] = {0};
+	// --modes: the config is parsed and globbed once, each mode only adds its flags
+	compiler_conf *confs = &cconf;
+	size_t confs_n = 1;
+	char **modes = NULL;
+	size_t modes_n = 0;
+	if (opts->modes){
+		modes = _str_split(opts->modes, ',', &modes_n);
+		confs = calloc(modes_n ? modes_n : 1, sizeof(compiler_conf));
+		if (!modes || !confs){
+			exit(-1);
+		}
+		for (size_t i = 0; i < modes_n; i++){
+			if (config_for_mode(conf, &cconf, modes[i], &confs[i]) != 0){
+				exit(-1);
+			}
+		}
+		confs_n = modes_n;
+	}
 
-	if (MAIN_DIR){
-		snprintf(cmd, 15000, "MAIN_DIR=%s ", MAIN_DIR);
+	job_list jobs;
+	jobs_init(&jobs);
+	jobs.output = opts->progress;
+	jobs_setenv(&jobs, "MAIN_DIR", MAIN_DIR);
+
+	double plan_started = stats_now_ms();
+	int planned = 0;
+	for (size_t i = 0; i < confs_n && planned == 0; i++){
+		// --profile-compile measures this configuration only, modules keep their objects
+		planned = build_config_emit_jobs(opts->force_recompile || opts->profile, &confs[i], &jobs);
+	}
+	abs_stats.plan_ms += stats_now_ms() - plan_started;
+	if (0 != planned){
+		printf("%s[gen]%s: %s: build %sFAIL%s\n", abs_fore.blue, abs_fore.normal, prj_name ? prj_name: "<program>", abs_fore.red, abs_fore.normal);
+		exit(-1);
 	}
 
-	build_config_emit_cmd(force_recompile, &cconf, cmd + strlen(cmd), sizeof(cmd) - strlen(cmd));
+	// own sources still compile, but nothing links against a failed module
+	for (size_t i = 0; modules_failed && i < jobs.n; i++){
+		if (jobs.jobs[i].kind == JOB_LINK) jobs.jobs[i].state = JOB_SKIPPED;
+	}
 
-    printf("%s[gen]%s command: %s%s%s\n", abs_fore.blue, abs_fore.normal, abs_fore.gray, cmd, abs_fore.normal);
-	int r = system(cmd);
+	if (opts->progress == JOBS_OUTPUT_PLAIN || opts->dry_run){
+		char cmd[15000] = {0};
+		jobs_format(&jobs, cmd, sizeof(cmd));
+		printf("%s[gen]%s command: %s%s%s\n", abs_fore.blue, abs_fore.normal, abs_fore.gray, cmd, abs_fore.normal);
+	} else {
+		printf("%s[plan]%s %zu to compile, %zu up to date, %zu jobs\n", abs_fore.blue, abs_fore.normal,
+		       abs_stats.compiled, abs_stats.up_to_date, jobs.n);
+	}
+	int parallel = opts->jobs > 0 ? opts->jobs : cconf.jobs;
+	if (opts->dry_run){
+		printf("%s[dry-run]%s %zu jobs would run\n", abs_fore.blue, abs_fore.normal, jobs.n);
+		jobs_free(&jobs);
+		goto _free;
+	}
+	// durations of earlier runs give the status line its ETA
+	char history[PATH_MAX + 64];
+	bool have_history = abs_state_path(cconf.obj_dir, "jobs", history, sizeof(history)) == 0;
+	if (have_history) jobs_history_load(&jobs, history);
+	failed = jobs_run(&jobs, parallel, opts->keep_going);
+	if (have_history) jobs_history_save(&jobs, history);
+	if (opts->keep_going) jobs_summary(&jobs);
+	stats_report(&jobs, parallel);
+	profile_report(&cconf, &jobs);
+	jobs_free(&jobs);
+	for (size_t i = 0; failed == 0 && i < confs_n; i++){
+		char out_path[PATH_MAX];
+		get_output_path(&confs[i], out_path, sizeof(out_path));
+		shared_report_exports(&confs[i], out_path);
+	}
 
-	if (r == 0 && !MAIN_DIR){
+	if (failed == 0 && modules_failed == 0 && !MAIN_DIR){
 		printf("%s[gen]%s: %s: build %sSUCCESS%s\n", abs_fore.blue, abs_fore.normal, prj_name ? prj_name: "<program>", abs_fore.green, abs_fore.normal);
 	} else if (!MAIN_DIR){
 		printf("%s[gen]%s: %s: build %sFAIL%s\n", abs_fore.blue, abs_fore.normal, prj_name ? prj_name: "<program>", abs_fore.red, abs_fore.normal);
 		exit(-1);
 	}
 
+_free:
+	// mode directories go first, so cleanup can remove the objects directory itself
+	for (size_t i = 0; modes && i < confs_n; i++) config_mode_free(&confs[i]);
+	if (modes) free(confs);
+	for (size_t i = 0; i < modes_n; i++) free(modes[i]);
+	free(modes);
 	compiler_conf_free(&cconf);
 
 _end:
+	return (failed || modules_failed) ? -1 : 0;
+}
+
+int build(const char *prog, const char *confpath, const build_opts *opts){
+	ini_config conf;
+	double load_started = stats_now_ms();
+	int loaded = ini_load_file(&conf, confpath);
+	abs_stats.ini_ms += stats_now_ms() - load_started;
+	if (0 > loaded){
+		fprintf(stderr, "%sfailed%s to load configuration: %s%s%s\naborting\n", abs_fore.red, abs_fore.normal, abs_fore.gray, confpath, abs_fore.normal);
+		return -1;
+	}
+
+	int r = build_loaded(prog, confpath, &conf, opts);
 	ini_clear_config(&conf);
-	return 0;
+	return r;
 }
 
 int main(int argc, const char *argv[]){
-	if (argc == 1){
-		return build(argv[0], "abs.conf", 0);
+	const char *confpath = "abs.conf";
+	build_opts opts = {0};
+	bool server = false, stop_server = false, no_server = false, emit_ninja = false;
+	bool test = false, bench = false, install = false;
+	const char *progress = "auto";
+	test_opts topts = {0};
+	bench_opts bopts = {0};
+
+	if (argc > 1 && strcmp("--remote-cc", argv[1]) == 0){
+		return executor_remote_compile(argc - 2, argv + 2);
+	}
+	if (argc == 4 && strcmp("--restat", argv[1]) == 0){
+		return restat_output(argv[2], argv[3]) == 0 ? 0 : 1;
 	}
+	abs_stats.start_ms = stats_now_ms();
 
-	if (argc == 2) {
-		if (strcmp("-h", argv[1]) == 0 || strcmp("--help", argv[1]) == 0){
-			usage(argv[0]);
-		}
+	for (int i = 1; i < argc; i++){
+		const char *arg = argv[i];
 
-		if (strcmp("gen", argv[1]) == 0){
+		if (strcmp("-h", arg) == 0 || strcmp("--help", arg) == 0){
+			usage(argv[0]);
+		} else if (strcmp("--docs", arg) == 0 || strcmp("-d", arg) == 0){
+			docs();
+			return 0;
+		} else if (strcmp("gen", arg) == 0){
 			gen();
 			return 0;
+		} else if (strcmp("test", arg) == 0){
+			test = true;
+		} else if (strcmp("-j", arg) == 0 && i + 1 < argc){
+			opts.jobs = atoi(argv[++i]);
+			topts.jobs = opts.jobs;
+		} else if (strcmp("--shard", arg) == 0 && i + 1 < argc){
+			if (sscanf(argv[++i], "%d/%d", &topts.shard, &topts.shards) != 2 ||
+			    topts.shards < 1 || topts.shard < 1 || topts.shard > topts.shards){
+				fprintf(stderr, "%s[error]%s --shard expects I/N with 1 <= I <= N\n", abs_fore.red, abs_fore.normal);
+				return -1;
+			}
+		} else if (strcmp("--all", arg) == 0){
+			topts.all = true;
+		} else if (strcmp("bench", arg) == 0){
+			bench = true;
+		} else if (strcmp("install", arg) == 0){
+			install = true;
+		} else if (strcmp("--save-baseline", arg) == 0){
+			bopts.save_baseline = true;
+		} else if (strcmp("--baseline", arg) == 0 && i + 1 < argc){
+			bopts.baseline = argv[++i];
+		} else if (strcmp("--modes", arg) == 0 && i + 1 < argc){
+			opts.modes = argv[++i];
+		} else if (strcmp("-r", arg) == 0){
+			opts.force_recompile = 1;
+		} else if (strcmp("--progress", arg) == 0 && i + 1 < argc){
+			progress = argv[++i];
+		} else if (strcmp("--profile-compile", arg) == 0){
+			// every object has to compile to be measured
+			opts.profile = true;
+		} else if (strcmp("--emit-ninja", arg) == 0){
+			emit_ninja = true;
+		} else if (strcmp("--explain", arg) == 0){
+			opts.explain = true;
+		} else if (strcmp("-n", arg) == 0 || strcmp("--dry-run", arg) == 0){
+			opts.dry_run = true;
+		} else if (strcmp("--stats", arg) == 0){
+			opts.stats = true;
+			abs_stats.enabled = true;
+		} else if (strcmp("-k", arg) == 0 || strcmp("--keep-going", arg) == 0){
+			opts.keep_going = true;
+		} else if (strcmp("--server", arg) == 0){
+			server = true;
+		} else if (strcmp("--stop-server", arg) == 0){
+			stop_server = true;
+		} else if (strcmp("--no-server", arg) == 0){
+			no_server = true;
+		} else if (arg[0] == '-'){
+			usage(argv[0]);
+		} else {
+			confpath = arg;
 		}
+	}
 
-		if (strcmp("--docs", argv[1]) == 0 || strcmp("-d", argv[1]) == 0){
-			docs();
-			return 0;
-		}
+	// a live status line needs a terminal, logs and CI get one line per job
+	if (strcmp(progress, "auto") == 0){
+		const char *term = getenv("TERM");
+		bool tty = isatty(STDOUT_FILENO) && term && strcmp(term, "dumb") != 0;
+		opts.progress = tty ? JOBS_OUTPUT_STATUS : JOBS_OUTPUT_LINES;
+	} else if (strcmp(progress, "status") == 0){
+		opts.progress = JOBS_OUTPUT_STATUS;
+	} else if (strcmp(progress, "lines") == 0){
+		opts.progress = JOBS_OUTPUT_LINES;
+	} else if (strcmp(progress, "plain") == 0){
+		opts.progress = JOBS_OUTPUT_PLAIN;
+	} else {
+		usage(argv[0]);
+	}
 
-		if (strcmp("-r", argv[1]) == 0){
-			printf("Forcing recompile...\n");
-			return build(argv[0], "abs.conf", 1);
+	if (emit_ninja){
+		return ninja_emit(confpath, &opts) == 0 ? 0 : -1;
+	}
+	if (server){
+		return server_run(argv[0], confpath, build_loaded);
+	}
+	if (stop_server){
+		if (server_client_request(confpath, "stop\n") == -2){
+			fprintf(stderr, "%s[server]%s no server running for %s\n", abs_fore.red, abs_fore.normal, confpath);
+			return -1;
 		}
+		return 0;
+	}
 
-		return build(argv[0], argv[1], 0);
+	if (opts.force_recompile && !getenv("MAIN_DIR")){
+		printf("Forcing recompile...\n");
 	}
 
-	if (argc == 3){
-		if (strcmp("-r", argv[1]) == 0){
-			return build(argv[0], argv[2], 1);
-		} else {
-			usage(argv[0]);
-		}
+	// benchmarks always measure a release build, which the server does not keep
+	if (bench){
+		setenv("ABS_MODE", "release", 1);
+		no_server = true;
+	}
+	// the server's phases happened in another process, so measure a local build;
+	// it also keeps a single configuration
+	if (opts.stats || opts.explain || opts.dry_run || opts.modes || opts.profile){
+		no_server = true;
 	}
 
-	usage(argv[0]);
+	// module builds always run locally, under the parent's server if any
+	int r = -2;
+	if (!no_server && !getenv("MAIN_DIR")){
+		r = server_client_build(confpath, &opts);
+		if (r != -2) r = r == 0 ? 0 : -1;
+	}
+	if (r == -2){
+		r = build(argv[0], confpath, &opts);
+	}
+	if (!(test || bench || install) || r != 0){
+		return r;
+	}
+
+	ini_config conf;
+	if (0 > ini_load_file(&conf, confpath)){
+		fprintf(stderr, "%sfailed%s to load configuration: %s%s%s\naborting\n", abs_fore.red, abs_fore.normal, abs_fore.gray, confpath, abs_fore.normal);
+		return -1;
+	}
+	int failed = bench ? bench_run(&conf, &bopts) : install ? install_run(&conf) : tests_run(&conf, &topts);
+	ini_clear_config(&conf);
+	return failed == 0 ? 0 : -1;
 }
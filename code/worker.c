@@ -0,0 +1,227 @@
+#include "abs/colors.h"
+#include <abs/executor.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+/*
+ * Reference worker for the abs remote executor. Every connection carries
+ * one preprocessed translation unit; it is compiled in a scratch directory
+ * and the object plus diagnostics are sent back.
+ *
+ * A worker runs the client's compiler flags, so only expose it to hosts
+ * and containers you trust.
+ */
+
+static const char *default_allow = "cc gcc g++ c++ clang clang++";
+
+// flags that load code, pick other tools or write files outside the scratch dir
+static const char *denied_prefixes[] = {
+	"-fplugin", "-specs", "-B", "-wrapper", "-o", "-M", "-save-temps", "-fdump", "--sysroot", "@",
+	"-aux-info", "-dumpdir", "-dumpbase", "-Wp,", "-Xpreprocessor", NULL
+};
+
+// assembler options that write files: listings (-a...=FILE), --MD FILE and -o FILE
+static const char *denied_asm_prefixes[] = { "-a", "--listing", "--MD", "-o", NULL };
+
+void usage(const char *prog){
+	printf(
+		"usage: %s [-j N] [--allow \"cc gcc ...\"] ENDPOINT"
+		"\n\nENDPOINT - unix:PATH, tcp:PORT (loopback only) or tcp:HOST:PORT\n"
+		"-j N - compile at most N units at once, by default the number of cores\n"
+		"--allow - compilers clients may run, by default \"%s\";\n"
+		"  names only, looked up in this worker's $PATH\n"
+		"-h/--help - show this message and exit\n", prog, default_allow);
+	exit(EXIT_SUCCESS);
+}
+
+static int has_denied_prefix(const char *arg, const char **prefixes){
+	for (int i = 0; prefixes[i] != NULL; i++){
+		if (strncmp(arg, prefixes[i], strlen(prefixes[i])) == 0) return 1;
+	}
+	return 0;
+}
+
+// `prev` is the argument before `arg`, for -Xassembler OPTION
+static int arg_allowed(const char *arg, const char *prev){
+	if (prev && strcmp(prev, "-Xassembler") == 0) return !has_denied_prefix(arg, denied_asm_prefixes);
+	if (strncmp(arg, "-Wa,", 4) == 0){
+		char *opts = strdup(arg + 4);
+		char *saveptr = NULL;
+		int ok = opts != NULL;
+		for (char *opt = strtok_r(opts, ",", &saveptr); opt && ok; opt = strtok_r(NULL, ",", &saveptr))
+			ok = !has_denied_prefix(opt, denied_asm_prefixes);
+		free(opts);
+		return ok;
+	}
+	return !has_denied_prefix(arg, denied_prefixes);
+}
+
+static int compiler_allowed(const char *allow, const char *cc){
+	char *list = strdup(allow);
+	char *saveptr = NULL;
+	int ok = 0;
+	for (char *tok = strtok_r(list, " ", &saveptr); tok && !ok; tok = strtok_r(NULL, " ", &saveptr)){
+		ok = strcmp(tok, cc) == 0;
+	}
+	free(list);
+	return ok;
+}
+
+static void reply(FILE *w, int status, const char *diag, size_t diag_len, const char *obj, size_t obj_len){
+	fputs(ABS_EXEC_MAGIC, w);
+	fprintf(w, "%d\n", status);
+	exec_write_blob(w, diag, diag_len);
+	exec_write_blob(w, obj, obj_len);
+	fflush(w);
+}
+
+static void reply_error(FILE *w, const char *msg){
+	char diag[512];
+	int len = snprintf(diag, sizeof(diag), "abs-worker: %s\n", msg);
+	reply(w, 1, diag, len, "", 0);
+}
+
+static void serve(int fd, const char *allow){
+	FILE *r = fdopen(dup(fd), "r");
+	FILE *w = fdopen(fd, "w");
+	if (!r || !w) return;
+
+	int argc = 0;
+	if (exec_read_magic(r) != 0 || fscanf(r, "%d", &argc) != 1 || fgetc(r) != '\n' ||
+	    argc < 1 || argc > ABS_EXEC_MAX_ARGS){
+		reply_error(w, "malformed request");
+		fclose(r); fclose(w);
+		return;
+	}
+
+	char **argv = calloc(argc + 4, sizeof(char*));
+	int ok = argv != NULL;
+	for (int i = 0; ok && i < argc; i++){
+		argv[i] = exec_read_blob(r, NULL);
+		ok = argv[i] != NULL;
+	}
+	size_t src_len = 0;
+	char *src = ok ? exec_read_blob(r, &src_len) : NULL;
+	fclose(r);
+
+	char dir[] = "/tmp/abs-worker-XXXXXX";
+	char in_path[64], out_path[64], diag_path[64];
+
+	if (!ok || !src) reply_error(w, "malformed request");
+	// a path would run whatever binary the client names, only $PATH lookups are allowed
+	else if (strchr(argv[0], '/') || !compiler_allowed(allow, argv[0])) reply_error(w, "compiler not allowed");
+	else if (!mkdtemp(dir)) reply_error(w, "no scratch directory");
+	else {
+		for (int i = 1; i < argc && ok; i++) ok = arg_allowed(argv[i], i > 1 ? argv[i - 1] : NULL);
+
+		snprintf(in_path, sizeof(in_path), "%s/in.i", dir);
+		snprintf(out_path, sizeof(out_path), "%s/out.o", dir);
+		snprintf(diag_path, sizeof(diag_path), "%s/diag", dir);
+
+		if (!ok) reply_error(w, "argument not allowed");
+		else if (exec_write_file(in_path, src, src_len) != 0) reply_error(w, "cannot write input");
+		else {
+			argv[argc] = in_path;
+			argv[argc + 1] = "-o";
+			argv[argc + 2] = out_path;
+			argv[argc + 3] = NULL;
+
+			int status = 1;
+			pid_t pid = fork();
+			if (pid == 0){
+				int dfd = open(diag_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+				if (dfd >= 0){
+					dup2(dfd, STDOUT_FILENO);
+					dup2(dfd, STDERR_FILENO);
+					close(dfd);
+				}
+				if (chdir(dir) != 0) _exit(127);
+				execvp(argv[0], argv);
+				_exit(127);
+			}
+			int wstatus;
+			if (pid > 0 && waitpid(pid, &wstatus, 0) == pid && WIFEXITED(wstatus))
+				status = WEXITSTATUS(wstatus);
+
+			size_t diag_len = 0, obj_len = 0;
+			char *diag = exec_read_file(diag_path, &diag_len);
+			char *obj = status == 0 ? exec_read_file(out_path, &obj_len) : NULL;
+			if (status == 0 && !obj) status = 1;
+			reply(w, status, diag ? diag : "", diag ? diag_len : 0, obj ? obj : "", obj ? obj_len : 0);
+			free(diag);
+			free(obj);
+
+			argv[argc] = NULL;
+			argv[argc + 1] = NULL;
+			argv[argc + 2] = NULL;
+		}
+
+		unlink(in_path);
+		unlink(out_path);
+		unlink(diag_path);
+		rmdir(dir);
+	}
+
+	for (int i = 0; argv && i < argc; i++) free(argv[i]);
+	free(argv);
+	free(src);
+	fclose(w);
+}
+
+int main(int argc, const char *argv[]){
+	const char *endpoint = NULL;
+	const char *allow = default_allow;
+	long max_jobs = sysconf(_SC_NPROCESSORS_ONLN);
+
+	for (int i = 1; i < argc; i++){
+		if (strcmp("-h", argv[i]) == 0 || strcmp("--help", argv[i]) == 0){
+			usage(argv[0]);
+		} else if (strcmp("-j", argv[i]) == 0 && i + 1 < argc){
+			max_jobs = atol(argv[++i]);
+		} else if (strcmp("--allow", argv[i]) == 0 && i + 1 < argc){
+			allow = argv[++i];
+		} else if (argv[i][0] == '-'){
+			usage(argv[0]);
+		} else {
+			endpoint = argv[i];
+		}
+	}
+	if (!endpoint) usage(argv[0]);
+	if (max_jobs < 1) max_jobs = 1;
+
+	int listen_fd = executor_socket(endpoint, true);
+	if (listen_fd < 0){
+		fprintf(stderr, "%sfailed%s to listen on %s: %s\n", abs_fore.red, abs_fore.normal, endpoint, strerror(errno));
+		return -1;
+	}
+	signal(SIGPIPE, SIG_IGN);
+
+	printf("%s[worker]%s listening on %s, %ld jobs\n", abs_fore.green, abs_fore.normal, endpoint, max_jobs);
+	fflush(stdout);
+
+	long running = 0;
+	for (;;){
+		// reap finished compiles, blocking while every slot is busy
+		while (running > 0 && waitpid(-1, NULL, running >= max_jobs ? 0 : WNOHANG) > 0) running--;
+
+		int client = accept(listen_fd, NULL, NULL);
+		if (client < 0){
+			if (errno == EINTR) continue;
+			break;
+		}
+
+		pid_t pid = fork();
+		if (pid == 0){
+			close(listen_fd);
+			serve(client, allow);
+			_exit(0);
+		}
+		close(client);
+		if (pid > 0) running++;
+	}
+
+	close(listen_fd);
+	return 0;
+}
@@ -0,0 +1,10 @@
+#include <stdio.h>
+#include <stddef.h>
+
+long sum(const int *v, size_t n);
+
+int main(void){
+    int v[] = {1, 2, 3, 4, 5};
+    printf("sum: %ld\n", sum(v, sizeof(v) / sizeof(v[0])));
+    return 0;
+}